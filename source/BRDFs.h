@@ -61,19 +61,38 @@ namespace dae
 			return { f0 + (ColorRGB{1,1,1} - f0) * powf((1 - dot),5)};
 		}
 
+		/**
+		 * \param roughness Roughness of the material
+		 * \return Squared alpha of the GGX distribution, alpha being squared(roughness) (UE4)
+		 */
+		static float GetAlpha4(float roughness)
+		{
+			return roughness * roughness * roughness * roughness;
+		}
+
+		/**
+		 * \param roughness Roughness of the material
+		 * \return k of the SchlickGGX geometry term for direct lighting (UE4)
+		 */
+		static float GetSchlickK(float roughness)
+		{
+			const float a{ Square(roughness) };
+			return (a + 1) * (a + 1) / 8;
+		}
+
 		/**
 		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX (UE4 implemetation - squared(roughness))
 		 * \param n Surface normal
 		 * \param h Normalized half vector
-		 * \param roughness Roughness of the material
+		 * \param alpha4 GetAlpha4(roughness), computed once per material
 		 * \return BRDF Normal Distribution Term using Trowbridge-Reitz GGX
 		 */
-		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, float roughness)
+		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, float alpha4)
 		{
 			//todo: W3
 			//assert(false && "Not Implemented Yet");
 			const float nhDot{ std::min(1.f,std::max(Vector3::Dot(n,h),0.f)) };
-			const float aSrqr{ roughness * roughness * roughness * roughness };
+			const float aSrqr{ alpha4 };
 			const float denominator{ (nhDot * nhDot) * (aSrqr - 1) + 1 };
 			return { aSrqr / (float(M_PI) * denominator * denominator) };
 		}
@@ -83,15 +102,13 @@ namespace dae
 		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
-		 * \param roughness Roughness of the material
+		 * \param k GetSchlickK(roughness), computed once per material
 		 * \return BRDF Geometry Term using SchlickGGX
 		 */
-		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float roughness)
+		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float k)
 		{
 			//todo: W3
 			const float dot{ std::min(1.f, std::max(Vector3::Dot(n,v),0.f)) };
-			const float a{ Square(roughness) };
-			const float k{ (a + 1) * (a + 1) / 8 };
 			return { dot / (dot * (1 - k) + k) };
 		}
 
@@ -100,15 +117,60 @@ namespace dae
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
 		 * \param l Normalized light direction
-		 * \param roughness Roughness of the material
-		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,roughness) * SchlickGGX(n,l,roughness))
+		 * \param k GetSchlickK(roughness), computed once per material
+		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,k) * SchlickGGX(n,l,k))
 		 */
-		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, float roughness)
+		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, float k)
 		{
 			//todo: W3
 			//assert(false && "Not Implemented Yet");
 
-			return GeometryFunction_SchlickGGX(n, v, roughness) * GeometryFunction_SchlickGGX(n, l, roughness);
+			return GeometryFunction_SchlickGGX(n, v, k) * GeometryFunction_SchlickGGX(n, l, k);
+		}
+
+		/**
+		 * \brief Half vector distributed like the GGX normal distribution times n.h
+		 * \param n Normal of the surface
+		 * \param alpha4 GetAlpha4(roughness), computed once per material
+		 * \param u, v Uniform random numbers in [0, 1)
+		 * \return Normalized half vector, reflecting the view direction around it gives the light direction
+		 */
+		static Vector3 SampleHalfVector_GGX(const Vector3& n, float alpha4, float u, float v)
+		{
+			const float cosTheta{ sqrtf((1.f - u) / (1.f + (alpha4 - 1.f) * u)) };
+			const float sinTheta{ sqrtf(std::max(0.f, 1.f - cosTheta * cosTheta)) };
+			const float phi{ PI_2 * v };
+			const Vector3 tangent{ (fabsf(n.x) > 0.9f ? Vector3::Cross(n, Vector3::UnitY) : Vector3::Cross(n, Vector3::UnitX)).Normalized() };
+			const Vector3 bitangent{ Vector3::Cross(n, tangent) };
+			return tangent * (cosf(phi) * sinTheta) + bitangent * (sinf(phi) * sinTheta) + n * cosTheta;
+		}
+
+		/**
+		 * \brief Direction distributed like the cosine to n, the density is n.l / PI
+		 * \param n Normal of the surface
+		 * \param u, v Uniform random numbers in [0, 1)
+		 */
+		static Vector3 SampleDirection_Cosine(const Vector3& n, float u, float v)
+		{
+			const float sinTheta{ sqrtf(u) };
+			const float cosTheta{ sqrtf(1.f - u) };
+			const float phi{ PI_2 * v };
+			const Vector3 tangent{ (fabsf(n.x) > 0.9f ? Vector3::Cross(n, Vector3::UnitY) : Vector3::Cross(n, Vector3::UnitX)).Normalized() };
+			const Vector3 bitangent{ Vector3::Cross(n, tangent) };
+			return tangent * (cosf(phi) * sinTheta) + bitangent * (sinf(phi) * sinTheta) + n * cosTheta;
+		}
+
+		/**
+		 * \brief Exact Fresnel reflectance of unpolarized light at the boundary of two dielectrics
+		 * \param cosIncident Cosine between the normal and the incoming direction, on the side the light comes from
+		 * \param cosTransmitted Cosine between the normal and the refracted direction
+		 * \param eta Index of refraction of the incoming side divided by that of the other side
+		 */
+		static float Fresnel_Dielectric(float cosIncident, float cosTransmitted, float eta)
+		{
+			const float perpendicular{ (eta * cosIncident - cosTransmitted) / (eta * cosIncident + cosTransmitted) };
+			const float parallel{ (cosIncident - eta * cosTransmitted) / (cosIncident + eta * cosTransmitted) };
+			return 0.5f * (perpendicular * perpendicular + parallel * parallel);
 		}
 
 	}
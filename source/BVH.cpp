@@ -0,0 +1,237 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr int SAH_BIN_COUNT{ 12 };
+
+		struct BuildBounds
+		{
+			Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			void Grow(const Vector3& point)
+			{
+				min = Vector3::Min(min, point);
+				max = Vector3::Max(max, point);
+			}
+
+			void Grow(const BuildBounds& bounds)
+			{
+				min = Vector3::Min(min, bounds.min);
+				max = Vector3::Max(max, bounds.max);
+			}
+
+			float HalfArea() const
+			{
+				const Vector3 extent{ max - min };
+				if (extent.x < 0.f) return 0.f;
+				return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+			}
+		};
+
+		struct SAHBin
+		{
+			BuildBounds bounds{};
+			uint32_t triangleCount{};
+		};
+
+		struct BuildContext
+		{
+			std::vector<uint32_t> triangleOrder{};
+			std::vector<BuildBounds> triangleBounds{};
+			std::vector<Vector3> centroids{};
+		};
+
+		void UpdateNodeBounds(BVHNode& node, const BuildContext& context)
+		{
+			BuildBounds bounds{};
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; ++i)
+			{
+				bounds.Grow(context.triangleBounds[context.triangleOrder[i]]);
+			}
+			node.minAABB = bounds.min;
+			node.maxAABB = bounds.max;
+		}
+
+		//Returns the split cost, axis and position of the cheapest binned split
+		float FindBestSplit(const BVHNode& node, const BuildContext& context, int& bestAxis, float& bestPosition)
+		{
+			BuildBounds centroidBounds{};
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; ++i)
+			{
+				centroidBounds.Grow(context.centroids[context.triangleOrder[i]]);
+			}
+
+			float bestCost{ FLT_MAX };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float boundsMin{ centroidBounds.min[axis] };
+				const float boundsMax{ centroidBounds.max[axis] };
+				if (boundsMax <= boundsMin) continue;
+
+				SAHBin bins[SAH_BIN_COUNT]{};
+				const float binScale{ SAH_BIN_COUNT / (boundsMax - boundsMin) };
+				for (uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; ++i)
+				{
+					const uint32_t triangle{ context.triangleOrder[i] };
+					const int binIndex{ std::min(SAH_BIN_COUNT - 1, int((context.centroids[triangle][axis] - boundsMin) * binScale)) };
+					++bins[binIndex].triangleCount;
+					bins[binIndex].bounds.Grow(context.triangleBounds[triangle]);
+				}
+
+				//Sweep from both sides to get the cost of every plane between two bins
+				float leftArea[SAH_BIN_COUNT - 1]{}, rightArea[SAH_BIN_COUNT - 1]{};
+				uint32_t leftCount[SAH_BIN_COUNT - 1]{}, rightCount[SAH_BIN_COUNT - 1]{};
+				BuildBounds leftBounds{}, rightBounds{};
+				uint32_t leftSum{}, rightSum{};
+				for (int i = 0; i < SAH_BIN_COUNT - 1; ++i)
+				{
+					leftSum += bins[i].triangleCount;
+					leftCount[i] = leftSum;
+					leftBounds.Grow(bins[i].bounds);
+					leftArea[i] = leftBounds.HalfArea();
+
+					rightSum += bins[SAH_BIN_COUNT - 1 - i].triangleCount;
+					rightCount[SAH_BIN_COUNT - 2 - i] = rightSum;
+					rightBounds.Grow(bins[SAH_BIN_COUNT - 1 - i].bounds);
+					rightArea[SAH_BIN_COUNT - 2 - i] = rightBounds.HalfArea();
+				}
+
+				for (int i = 0; i < SAH_BIN_COUNT - 1; ++i)
+				{
+					const float planeCost{ leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i] };
+					if (planeCost < bestCost)
+					{
+						bestCost = planeCost;
+						bestAxis = axis;
+						bestPosition = boundsMin + (i + 1) / binScale;
+					}
+				}
+			}
+			return bestCost;
+		}
+	}
+
+	void BVH::Build(const std::vector<Vector3>& positions, std::vector<int>& indices, std::vector<BVHNode>& nodes)
+	{
+		nodes.clear();
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+		if (triangleCount == 0) return;
+
+		BuildContext context{};
+		context.triangleOrder.resize(triangleCount);
+		std::iota(context.triangleOrder.begin(), context.triangleOrder.end(), 0);
+		context.triangleBounds.resize(triangleCount);
+		context.centroids.resize(triangleCount);
+		for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			BuildBounds& bounds{ context.triangleBounds[triangle] };
+			bounds.Grow(positions[indices[triangle * 3]]);
+			bounds.Grow(positions[indices[triangle * 3 + 1]]);
+			bounds.Grow(positions[indices[triangle * 3 + 2]]);
+			context.centroids[triangle] = (bounds.min + bounds.max) * 0.5f;
+		}
+
+		nodes.reserve(size_t(triangleCount) * 2);
+		BVHNode root{};
+		root.leftFirst = 0;
+		root.triangleCount = triangleCount;
+		UpdateNodeBounds(root, context);
+		nodes.push_back(root);
+
+		struct PendingNode
+		{
+			uint32_t nodeIndex;
+			int depth;
+		};
+		std::vector<PendingNode> stack{ { 0, 0 } };
+		while (!stack.empty())
+		{
+			const PendingNode pending{ stack.back() };
+			stack.pop_back();
+
+			BVHNode node{ nodes[pending.nodeIndex] };
+			if (node.triangleCount <= MAX_LEAF_TRIANGLES || pending.depth >= MAX_DEPTH - 1) continue;
+
+			int axis{ -1 };
+			float splitPosition{};
+			const float splitCost{ FindBestSplit(node, context, axis, splitPosition) };
+			BuildBounds nodeBounds{ node.minAABB, node.maxAABB };
+			if (axis < 0 || splitCost >= node.triangleCount * nodeBounds.HalfArea()) continue;
+
+			const auto firstIt{ context.triangleOrder.begin() + node.leftFirst };
+			const auto splitIt{ std::partition(firstIt, firstIt + node.triangleCount,
+				[&](uint32_t triangle) { return context.centroids[triangle][axis] < splitPosition; }) };
+			const uint32_t leftCount{ static_cast<uint32_t>(splitIt - firstIt) };
+			if (leftCount == 0 || leftCount == node.triangleCount) continue;
+
+			BVHNode left{}, right{};
+			left.leftFirst = node.leftFirst;
+			left.triangleCount = leftCount;
+			right.leftFirst = node.leftFirst + leftCount;
+			right.triangleCount = node.triangleCount - leftCount;
+			UpdateNodeBounds(left, context);
+			UpdateNodeBounds(right, context);
+
+			const uint32_t leftIndex{ static_cast<uint32_t>(nodes.size()) };
+			nodes.push_back(left);
+			nodes.push_back(right);
+			nodes[pending.nodeIndex].leftFirst = leftIndex;
+			nodes[pending.nodeIndex].triangleCount = 0;
+
+			stack.push_back({ leftIndex, pending.depth + 1 });
+			stack.push_back({ leftIndex + 1, pending.depth + 1 });
+		}
+		nodes.shrink_to_fit();
+
+		//Store the triangles in leaf order
+		std::vector<int> orderedIndices(indices.size());
+		for (uint32_t i = 0; i < triangleCount; ++i)
+		{
+			const uint32_t triangle{ context.triangleOrder[i] };
+			orderedIndices[i * 3] = indices[triangle * 3];
+			orderedIndices[i * 3 + 1] = indices[triangle * 3 + 1];
+			orderedIndices[i * 3 + 2] = indices[triangle * 3 + 2];
+		}
+		indices.swap(orderedIndices);
+	}
+
+	void BVH::Refit(const std::vector<Vector3>& positions, const std::vector<int>& indices,
+		const std::vector<BVHNode>& sourceNodes, std::vector<BVHNode>& nodes)
+	{
+		nodes.resize(sourceNodes.size());
+
+		//Children are stored after their parent, walking backwards visits them first
+		for (size_t i = sourceNodes.size(); i-- > 0;)
+		{
+			BVHNode& node{ nodes[i] };
+			node.leftFirst = sourceNodes[i].leftFirst;
+			node.triangleCount = sourceNodes[i].triangleCount;
+
+			if (node.IsLeaf())
+			{
+				Vector3 minAABB{ positions[indices[node.leftFirst * 3]] };
+				Vector3 maxAABB{ minAABB };
+				for (uint32_t index = node.leftFirst * 3 + 1; index < (node.leftFirst + node.triangleCount) * 3; ++index)
+				{
+					minAABB = Vector3::Min(minAABB, positions[indices[index]]);
+					maxAABB = Vector3::Max(maxAABB, positions[indices[index]]);
+				}
+				node.minAABB = minAABB;
+				node.maxAABB = maxAABB;
+			}
+			else
+			{
+				const BVHNode& left{ nodes[node.leftFirst] };
+				const BVHNode& right{ nodes[node.leftFirst + 1] };
+				node.minAABB = Vector3::Min(left.minAABB, right.minAABB);
+				node.maxAABB = Vector3::Max(left.maxAABB, right.maxAABB);
+			}
+		}
+	}
+}
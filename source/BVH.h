@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//32 byte node, two fit in a cache line
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		uint32_t leftFirst{}; //Leaf: first triangle, Interior: left child (right child is leftFirst + 1)
+		Vector3 maxAABB{};
+		uint32_t triangleCount{}; //0 for interior nodes
+
+		bool IsLeaf() const { return triangleCount > 0; }
+	};
+
+	namespace BVH
+	{
+		constexpr uint32_t MAX_LEAF_TRIANGLES{ 4 };
+		constexpr int MAX_DEPTH{ 64 };
+
+		/**
+		 * \brief Builds a binned SAH bounding volume hierarchy over an indexed triangle list
+		 * \param positions vertex positions
+		 * \param indices triangle list, triangles get reordered so every leaf references a contiguous range
+		 * \param nodes output nodes, the root is nodes[0] and children are always stored after their parent
+		 */
+		void Build(const std::vector<Vector3>& positions, std::vector<int>& indices, std::vector<BVHNode>& nodes);
+
+		/**
+		 * \brief Recomputes the bounds of an existing hierarchy for new vertex positions, the topology is kept
+		 * \param positions (transformed) vertex positions
+		 * \param indices triangle list the hierarchy was built for
+		 * \param sourceNodes nodes returned by Build
+		 * \param nodes refitted nodes, resized to match sourceNodes
+		 */
+		void Refit(const std::vector<Vector3>& positions, const std::vector<int>& indices,
+			const std::vector<BVHNode>& sourceNodes, std::vector<BVHNode>& nodes);
+	}
+}
@@ -0,0 +1,146 @@
+#include "Checkpoint.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace dae
+{
+	namespace Checkpoint
+	{
+		bool Save(const std::string& filename, const RenderCheckpoint& checkpoint)
+		{
+			Header header{};
+			memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.headerSize = sizeof(Header);
+
+			header.width = checkpoint.width;
+			header.height = checkpoint.height;
+			header.lightCount = checkpoint.lightCount;
+
+			for (int axis = 0; axis < 3; ++axis)
+				header.cameraOrigin[axis] = checkpoint.cameraOrigin[axis];
+			header.cameraPitch = checkpoint.cameraPitch;
+			header.cameraYaw = checkpoint.cameraYaw;
+			header.cameraFovAngle = checkpoint.cameraFovAngle;
+			header.lightMode = checkpoint.settings.lightMode;
+			header.shadowsEnabled = checkpoint.settings.shadowsEnabled;
+			header.manyLightsEnabled = checkpoint.settings.manyLightsEnabled;
+			header.lightCullingEnabled = checkpoint.settings.lightCullingEnabled;
+			header.samplerType = uint8_t(checkpoint.settings.samplerType);
+			header.areaLightStrata = checkpoint.settings.areaLightStrata;
+			header.maxBounces = checkpoint.settings.maxBounces;
+			header.ambientOcclusionStrata = checkpoint.settings.ambientOcclusionStrata;
+			header.shadowCutoff = checkpoint.settings.shadowCutoff;
+			header.ambientOcclusionRadius = checkpoint.settings.ambientOcclusionRadius;
+			header.ambientRadiance = checkpoint.settings.ambientRadiance;
+
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int column = 0; column < 4; ++column)
+					header.cameraToWorld[row * 4 + column] = checkpoint.cameraToWorld[row][column];
+			}
+			header.fovFactor = checkpoint.fovFactor;
+			header.geometryVersion = checkpoint.geometryVersion;
+
+			header.frameIndex = checkpoint.frameIndex;
+			header.accumulatedFrames = checkpoint.accumulatedFrames;
+
+			const std::string tempPath{ filename + ".tmp" };
+			{
+				std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+				if (!file)
+					return false;
+
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				file.write(reinterpret_cast<const char*>(checkpoint.accumulation.data()),
+					static_cast<std::streamsize>(checkpoint.accumulation.size() * sizeof(ColorRGB)));
+				if (!file)
+					return false;
+			}
+
+			std::error_code error{};
+			std::filesystem::rename(tempPath, filename, error);
+			return !error;
+		}
+
+		bool Load(const std::string& filename, RenderCheckpoint& checkpoint)
+		{
+			const MappedFile file{ filename };
+			if (!file.IsOpen() || file.GetSize() < sizeof(Header))
+				return false;
+
+			Header header{};
+			memcpy(&header, file.GetData(), sizeof(Header));
+			if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.headerSize != sizeof(Header))
+				return false;
+			if (header.width <= 0 || header.height <= 0)
+				return false;
+			const size_t pixelCount{ size_t(header.width) * size_t(header.height) };
+			if ((file.GetSize() - sizeof(Header)) / sizeof(ColorRGB) != pixelCount)
+				return false;
+
+			checkpoint.width = header.width;
+			checkpoint.height = header.height;
+			checkpoint.lightCount = header.lightCount;
+
+			checkpoint.cameraOrigin = { header.cameraOrigin[0], header.cameraOrigin[1], header.cameraOrigin[2] };
+			checkpoint.cameraPitch = header.cameraPitch;
+			checkpoint.cameraYaw = header.cameraYaw;
+			checkpoint.cameraFovAngle = header.cameraFovAngle;
+			checkpoint.settings = { header.lightMode, header.shadowsEnabled != 0, header.manyLightsEnabled != 0,
+				header.lightCullingEnabled != 0, SamplerType(header.samplerType), header.areaLightStrata, header.maxBounces,
+				header.ambientOcclusionStrata, header.shadowCutoff, header.ambientOcclusionRadius, header.ambientRadiance };
+			//A damaged file can still carry the magic, its settings must not turn into out of range modes
+			if (!Renderer::AreSettingsValid(checkpoint.settings))
+				return false;
+
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int column = 0; column < 4; ++column)
+					checkpoint.cameraToWorld[row][column] = header.cameraToWorld[row * 4 + column];
+			}
+			checkpoint.fovFactor = header.fovFactor;
+			checkpoint.geometryVersion = header.geometryVersion;
+
+			checkpoint.frameIndex = header.frameIndex;
+			checkpoint.accumulatedFrames = header.accumulatedFrames;
+			checkpoint.accumulation.resize(pixelCount);
+			memcpy(checkpoint.accumulation.data(), file.GetData() + sizeof(Header), pixelCount * sizeof(ColorRGB));
+			return true;
+		}
+	}
+
+	CheckpointWriter::CheckpointWriter(const std::string& filename) :
+		m_Filename{ filename }
+	{
+	}
+
+	CheckpointWriter::~CheckpointWriter()
+	{
+		Flush();
+	}
+
+	void CheckpointWriter::Submit(RenderCheckpoint& checkpoint)
+	{
+		Flush();
+		std::swap(m_Checkpoint, checkpoint);
+		m_Thread = std::thread{ [this]
+			{
+				if (!Checkpoint::Save(m_Filename, m_Checkpoint))
+				{
+					++m_FailedCount;
+					std::cerr << "Cannot write checkpoint " << m_Filename << "\n";
+				}
+			} };
+	}
+
+	void CheckpointWriter::Flush()
+	{
+		if (m_Thread.joinable())
+			m_Thread.join();
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Renderer.h"
+
+namespace dae
+{
+	//Everything a progressive render needs to continue bit for bit in another process
+	struct RenderCheckpoint
+	{
+		int width{};
+		int height{};
+		uint32_t lightCount{};
+
+		//Restored before the next frame so it continues the same accumulation
+		Vector3 cameraOrigin{};
+		float cameraPitch{};
+		float cameraYaw{};
+		float cameraFovAngle{};
+		Renderer::Settings settings{};
+
+		//What the accumulation was rendered with, a next frame that differs starts over
+		Matrix cameraToWorld{};
+		float fovFactor{};
+		uint32_t geometryVersion{};
+
+		uint32_t frameIndex{}; //Frames rendered by the process, staggers the temporal reuse refreshes
+		uint32_t accumulatedFrames{}; //Samples of every pixel, all pixels get one per frame
+		std::vector<ColorRGB> accumulation{};
+	};
+
+	namespace Checkpoint
+	{
+		constexpr char MAGIC[8]{ 'R', 'T', 'C', 'H', 'E', 'C', 'K', '\0' };
+		constexpr uint32_t VERSION{ 5 };
+
+		//Little endian, followed by width * height RGB floats
+		struct Header
+		{
+			char magic[8]{};
+			uint32_t version{};
+			uint32_t headerSize{};
+
+			int32_t width{};
+			int32_t height{};
+			uint32_t lightCount{};
+
+			float cameraOrigin[3]{};
+			float cameraPitch{};
+			float cameraYaw{};
+			float cameraFovAngle{};
+			uint8_t lightMode{};
+			uint8_t shadowsEnabled{};
+			uint8_t manyLightsEnabled{};
+			uint8_t lightCullingEnabled{};
+			uint8_t samplerType{};
+			uint8_t areaLightStrata{};
+			uint8_t maxBounces{};
+			uint8_t ambientOcclusionStrata{};
+			float shadowCutoff{};
+			float ambientOcclusionRadius{};
+			float ambientRadiance{};
+
+			float cameraToWorld[16]{};
+			float fovFactor{};
+			uint32_t geometryVersion{};
+
+			uint32_t frameIndex{};
+			uint32_t accumulatedFrames{};
+		};
+
+		//Replaces filename through a temporary file, an interrupted write leaves the previous checkpoint intact
+		bool Save(const std::string& filename, const RenderCheckpoint& checkpoint);
+		//False if the file is missing, truncated or from another version
+		bool Load(const std::string& filename, RenderCheckpoint& checkpoint);
+	}
+
+	//Saves checkpoints on a background thread so the render loop only pays for copying the accumulation
+	class CheckpointWriter final
+	{
+	public:
+		explicit CheckpointWriter(const std::string& filename);
+		~CheckpointWriter();
+
+		CheckpointWriter(const CheckpointWriter&) = delete;
+		CheckpointWriter(CheckpointWriter&&) noexcept = delete;
+		CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+		CheckpointWriter& operator=(CheckpointWriter&&) noexcept = delete;
+
+		//Swaps the checkpoint in and starts writing it, waits when the previous one is still being written.
+		//The caller gets the previous checkpoint back, refilling it reuses its buffer
+		void Submit(RenderCheckpoint& checkpoint);
+		//Blocks until the checkpoint in progress is written
+		void Flush();
+
+		const std::string& GetFilename() const { return m_Filename; }
+		uint32_t GetFailedCount() const { return m_FailedCount; }
+
+	private:
+		std::string m_Filename{};
+		RenderCheckpoint m_Checkpoint{};
+		std::thread m_Thread{};
+		std::atomic<uint32_t> m_FailedCount{};
+	};
+}
@@ -2,17 +2,21 @@
 #include <cassert>
 
 #include "Math.h"
+#include "BVH.h"
 #include "vector"
 
 namespace dae
 {
+	//Index into the scene's material pool
+	using MaterialId = uint16_t;
+
 #pragma region GEOMETRY
 	struct Sphere
 	{
 		Vector3 origin{};
 		float radius{};
 		float radiusSqrt{};
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 
 	struct Plane
@@ -20,7 +24,7 @@ namespace dae
 		Vector3 origin{};
 		Vector3 normal{};
 
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 
 	enum class TriangleCullMode
@@ -51,7 +55,7 @@ namespace dae
 		Vector3 normal{};
 
 		TriangleCullMode cullMode{};
-		unsigned char materialIndex{};
+		MaterialId materialIndex{};
 	};
 
 	struct TriangleMesh
@@ -76,7 +80,7 @@ namespace dae
 		std::vector<Vector3> positions{};
 		//std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
+		MaterialId materialIndex{};
 
 		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
 
@@ -97,6 +101,13 @@ namespace dae
 		std::vector<Vector3> transformedPositions{};
 		//std::vector<Vector3> transformedNormals{};
 
+		//Object space hierarchy, refitted to the transformed positions in UpdateTransforms
+		std::vector<BVHNode> bvhNodes{};
+		std::vector<BVHNode> transformedBVHNodes{};
+
+		//Incremented every time the transformed geometry is rebuilt, lets the renderer detect moving meshes
+		uint32_t transformVersion{};
+
 		void UpdateAABB()
 		{
 			if(positions.size() > 0)
@@ -141,7 +152,7 @@ namespace dae
 			tMinAABB = Vector3::Min(tAABB, tMinAABB);
 			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
 
-			tAABB = finalTransform.TransformPoint(minAABB.x, maxAABB.y, minAABB.z);
+			tAABB = finalTransform.TransformPoint(minAABB.x, maxAABB.y, maxAABB.z);
 			tMinAABB = Vector3::Min(tAABB, tMinAABB);
 			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
 
@@ -182,9 +193,18 @@ namespace dae
 			scaleTransform = Matrix::CreateScale(scale);
 		}
 
+		//Reorders the triangles, call after all triangles are added
+		void BuildBVH()
+		{
+			BVH::Build(positions, indices, bvhNodes);
+			transformedBVHNodes.clear();
+		}
+
 		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
 		{
 			int startIndex = static_cast<int>(positions.size());
+			bvhNodes.clear();
+			transformedBVHNodes.clear();
 
 			positions.emplace_back(triangle.v0);
 			positions.emplace_back(triangle.v1);
@@ -226,14 +246,16 @@ namespace dae
 			//Calculate Final Transform 
 			const auto finalTransform = scaleTransform * rotationTransform * translationTransform;
 
-			//Transform Positions (positions > transformedPositions)
-			transformedPositions.clear();
-			transformedPositions.reserve(positions.size());
-			for (const Vector3& pos : positions)
+			//Transform Positions (positions > transformedPositions), overwritten in place so animated meshes never reallocate
+			transformedPositions.resize(positions.size());
+			for (size_t i = 0; i < positions.size(); ++i)
 			{
-				transformedPositions.emplace_back(finalTransform.TransformPoint(pos));
+				transformedPositions[i] = finalTransform.TransformPoint(positions[i]);
 			}
 			UpdateTransformedAABB(finalTransform);
+			if (!bvhNodes.empty())
+				BVH::Refit(transformedPositions, indices, bvhNodes, transformedBVHNodes);
+			++transformVersion;
 			//Transform Normals (normals > transformedNormals)
 			/*transformedNormals.clear();
 			transformedNormals.reserve(normals.size());
@@ -248,15 +270,27 @@ namespace dae
 	enum class LightType
 	{
 		Point,
-		Directional
+		Directional,
+		Sphere,
+		Quad
 	};
 
 	struct Light
 	{
+		//Centre of sphere and quad lights
 		Vector3 origin{};
+		//Directional lights shine opposite to it, quad lights emit on the side it points to
 		Vector3 direction{};
 		ColorRGB color{};
+		//Area lights give the radiance a point light of this intensity has straight in front of them
 		float intensity{};
+		//Point lights only, distance at which the light fades out completely. 0 means unbounded
+		float influenceRadius{};
+		//Sphere lights only
+		float radius{};
+		//Quad lights only, perpendicular edges from one side of the quad to the other
+		Vector3 edgeX{};
+		Vector3 edgeY{};
 
 		LightType type{};
 	};
@@ -278,8 +312,24 @@ namespace dae
 		float t = FLT_MAX;
 
 		bool didHit{ false };
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
+
+	};
 
+	//Last primitive that blocked a shadow ray, tested first by the next query towards the same light
+	struct Occluder
+	{
+		enum class Type : uint8_t
+		{
+			None,
+			Plane,
+			Sphere,
+			MeshTriangle
+		};
+
+		Type type{ Type::None };
+		uint32_t primitiveIndex{}; //Plane, sphere or mesh index
+		uint32_t triangleIndex{}; //MeshTriangle only, first index of the triangle in mesh.indices
 	};
 #pragma endregion
 }
\ No newline at end of file
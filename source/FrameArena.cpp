@@ -0,0 +1,116 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace dae;
+
+std::atomic<uint32_t> FrameArena::m_GlobalFrame{ 1 };
+
+void FrameArena::BeginFrame()
+{
+	m_GlobalFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameArena& FrameArena::Get()
+{
+	static thread_local FrameArena arena{};
+	const uint32_t frame{ m_GlobalFrame.load(std::memory_order_relaxed) };
+	if (arena.m_Frame != frame)
+	{
+		arena.Reset();
+		arena.m_Frame = frame;
+	}
+	return arena;
+}
+
+void* FrameArena::AllocateBytes(size_t size, size_t alignment)
+{
+	while (m_CurrentBlock < m_Blocks.size())
+	{
+		const Block& block{ m_Blocks[m_CurrentBlock] };
+		const size_t offset{ (m_Offset + alignment - 1) & ~(alignment - 1) };
+		if (offset + size <= block.size)
+		{
+			m_Offset = offset + size;
+			return block.pData.get() + offset;
+		}
+
+		//Blocks after the current one are left over from a rewound scope, reuse them before growing
+		++m_CurrentBlock;
+		m_Offset = 0;
+	}
+
+	//Memory handed out earlier this frame has to stay valid, so grow by adding a block instead of reallocating
+	const size_t blockSize{ std::max({ size, INITIAL_BLOCK_SIZE, m_Blocks.empty() ? 0 : m_Blocks.back().size * 2 }) };
+	m_Blocks.push_back({ std::make_unique_for_overwrite<std::byte[]>(blockSize), blockSize });
+	m_CurrentBlock = m_Blocks.size() - 1;
+	m_Offset = size;
+	return m_Blocks.back().pData.get();
+}
+
+void FrameArena::Reset()
+{
+	//A chain of blocks means the last frame did not fit, replace it by one block that holds all of it.
+	//After a few frames the arena stops allocating
+	if (m_Blocks.size() > 1)
+	{
+		size_t totalSize{};
+		for (const Block& block : m_Blocks)
+			totalSize += block.size;
+		m_Blocks.clear();
+		m_Blocks.push_back({ std::make_unique_for_overwrite<std::byte[]>(totalSize), totalSize });
+	}
+	m_CurrentBlock = 0;
+	m_Offset = 0;
+}
+
+#if defined(TRACK_HEAP_ALLOCATIONS)
+namespace
+{
+	std::atomic<size_t> g_HeapAllocationCount{};
+
+	void* CountedAllocate(size_t size)
+	{
+		g_HeapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		if (void* pMemory{ std::malloc(size ? size : 1) })
+			return pMemory;
+		throw std::bad_alloc{};
+	}
+
+	void* CountedAllocate(size_t size, std::align_val_t alignment)
+	{
+		g_HeapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		const size_t align{ static_cast<size_t>(alignment) };
+#if defined(_WIN32)
+		if (void* pMemory{ _aligned_malloc(size ? size : 1, align) })
+#else
+		if (void* pMemory{ std::aligned_alloc(align, (std::max(size, size_t{ 1 }) + align - 1) & ~(align - 1)) })
+#endif
+			return pMemory;
+		throw std::bad_alloc{};
+	}
+
+	void CountedFree(void* pMemory, std::align_val_t)
+	{
+#if defined(_WIN32)
+		_aligned_free(pMemory);
+#else
+		std::free(pMemory);
+#endif
+	}
+}
+
+size_t dae::GetHeapAllocationCount()
+{
+	return g_HeapAllocationCount.load(std::memory_order_relaxed);
+}
+
+//The array and nothrow forms forward to these by default
+void* operator new(size_t size) { return CountedAllocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return CountedAllocate(size, alignment); }
+void operator delete(void* pMemory) noexcept { std::free(pMemory); }
+void operator delete(void* pMemory, size_t) noexcept { std::free(pMemory); }
+void operator delete(void* pMemory, std::align_val_t alignment) noexcept { CountedFree(pMemory, alignment); }
+void operator delete(void* pMemory, size_t, std::align_val_t alignment) noexcept { CountedFree(pMemory, alignment); }
+#endif
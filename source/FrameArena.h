@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//Counts every global operator new, the renderer then asserts that steady state frames never touch the heap
+//#define TRACK_HEAP_ALLOCATIONS
+
+namespace dae
+{
+	//Bump allocator for scratch data that lives at most one frame, one per thread so allocating needs no locking.
+	//Nothing is freed or destructed individually, the whole arena is reset the first time its thread uses it in a new frame
+	class FrameArena final
+	{
+	public:
+		FrameArena() = default;
+		~FrameArena() = default;
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena(FrameArena&&) noexcept = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		FrameArena& operator=(FrameArena&&) noexcept = delete;
+
+		//Invalidates the memory handed out by every thread's arena, call once before rendering a frame
+		static void BeginFrame();
+		//Arena of the calling thread
+		static FrameArena& Get();
+
+		//Uninitialized storage for count objects, construct them before reading
+		template<typename T>
+		T* Allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Arena memory is never destructed");
+			static_assert(alignof(T) <= BLOCK_ALIGNMENT);
+			return static_cast<T*>(AllocateBytes(count * sizeof(T), alignof(T)));
+		}
+
+		//Gives back everything allocated while it was alive, for scratch data of a single pixel or tile
+		class Scope final
+		{
+		public:
+			explicit Scope(FrameArena& arena) : m_Arena{ arena }, m_Block{ arena.m_CurrentBlock }, m_Offset{ arena.m_Offset } {}
+			~Scope() { m_Arena.m_CurrentBlock = m_Block; m_Arena.m_Offset = m_Offset; }
+
+			Scope(const Scope&) = delete;
+			Scope(Scope&&) noexcept = delete;
+			Scope& operator=(const Scope&) = delete;
+			Scope& operator=(Scope&&) noexcept = delete;
+
+		private:
+			FrameArena& m_Arena;
+			size_t m_Block;
+			size_t m_Offset;
+		};
+
+	private:
+		static constexpr size_t BLOCK_ALIGNMENT{ __STDCPP_DEFAULT_NEW_ALIGNMENT__ };
+		static constexpr size_t INITIAL_BLOCK_SIZE{ 64 * 1024 };
+
+		struct Block
+		{
+			std::unique_ptr<std::byte[]> pData{};
+			size_t size{};
+		};
+
+		static std::atomic<uint32_t> m_GlobalFrame;
+
+		std::vector<Block> m_Blocks{};
+		size_t m_CurrentBlock{};
+		size_t m_Offset{};
+		uint32_t m_Frame{};
+
+		void* AllocateBytes(size_t size, size_t alignment);
+		void Reset();
+	};
+
+#if defined(TRACK_HEAP_ALLOCATIONS)
+	//Global operator new calls since startup, counted by the replacement operators in FrameArena.cpp
+	size_t GetHeapAllocationCount();
+#endif
+}
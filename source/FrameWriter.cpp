@@ -0,0 +1,338 @@
+//External includes
+#include "SDL_surface.h"
+
+//Project includes
+#include "FrameWriter.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		void AppendBytes(std::vector<uint8_t>& out, const void* pData, size_t size)
+		{
+			const uint8_t* pBytes{ static_cast<const uint8_t*>(pData) };
+			out.insert(out.end(), pBytes, pBytes + size);
+		}
+
+		void AppendLittleEndian(std::vector<uint8_t>& out, uint32_t value, int byteCount)
+		{
+			for (int byte{}; byte < byteCount; ++byte)
+				out.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+		}
+
+		void AppendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+		{
+			for (int byte{ 3 }; byte >= 0; --byte)
+				out.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+		}
+
+		uint32_t UpdateCrc32(uint32_t crc, const uint8_t* pData, size_t size)
+		{
+			static const std::array<uint32_t, 256> table{ []
+				{
+					std::array<uint32_t, 256> result{};
+					for (uint32_t n{}; n < 256; ++n)
+					{
+						uint32_t c{ n };
+						for (int k{}; k < 8; ++k)
+							c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+						result[n] = c;
+					}
+					return result;
+				}() };
+
+			crc = ~crc;
+			for (size_t i{}; i < size; ++i)
+				crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+			return ~crc;
+		}
+
+		void AppendPngChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* pData, size_t size)
+		{
+			AppendBigEndian(out, static_cast<uint32_t>(size));
+			const size_t typeOffset{ out.size() };
+			AppendBytes(out, type, 4);
+			AppendBytes(out, pData, size);
+			AppendBigEndian(out, UpdateCrc32(0, out.data() + typeOffset, size + 4));
+		}
+
+		//Rows of 8 bit RGB, top to bottom
+		void EncodePPM(const std::vector<uint8_t>& rgb, int width, int height, std::vector<uint8_t>& out)
+		{
+			const std::string header{ "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n" };
+			AppendBytes(out, header.data(), header.size());
+			AppendBytes(out, rgb.data(), rgb.size());
+		}
+
+		void EncodeBMP(const std::vector<uint8_t>& rgb, int width, int height, std::vector<uint8_t>& out)
+		{
+			//24 bit BGR, bottom up, rows padded to 4 bytes
+			const uint32_t rowSize{ (uint32_t(width) * 3 + 3) & ~3u };
+			const uint32_t imageSize{ rowSize * height };
+			out.push_back('B');
+			out.push_back('M');
+			AppendLittleEndian(out, 54 + imageSize, 4);
+			AppendLittleEndian(out, 0, 4);
+			AppendLittleEndian(out, 54, 4);
+			AppendLittleEndian(out, 40, 4);
+			AppendLittleEndian(out, width, 4);
+			AppendLittleEndian(out, height, 4);
+			AppendLittleEndian(out, 1, 2);
+			AppendLittleEndian(out, 24, 2);
+			AppendLittleEndian(out, 0, 4);
+			AppendLittleEndian(out, imageSize, 4);
+			AppendLittleEndian(out, 2835, 4);
+			AppendLittleEndian(out, 2835, 4);
+			AppendLittleEndian(out, 0, 4);
+			AppendLittleEndian(out, 0, 4);
+
+			for (int y{ height - 1 }; y >= 0; --y)
+			{
+				const uint8_t* pRow{ rgb.data() + size_t(y) * width * 3 };
+				for (int x{}; x < width; ++x)
+				{
+					out.push_back(pRow[x * 3 + 2]);
+					out.push_back(pRow[x * 3 + 1]);
+					out.push_back(pRow[x * 3]);
+				}
+				out.resize(out.size() + rowSize - width * 3);
+			}
+		}
+
+		void EncodePNG(const std::vector<uint8_t>& rgb, int width, int height, std::vector<uint8_t>& out)
+		{
+			static constexpr uint8_t signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			AppendBytes(out, signature, sizeof(signature));
+
+			std::vector<uint8_t> chunk{};
+			AppendBigEndian(chunk, width);
+			AppendBigEndian(chunk, height);
+			chunk.insert(chunk.end(), { 8, 2, 0, 0, 0 }); //8 bit RGB, no interlacing
+			AppendPngChunk(out, "IHDR", chunk.data(), chunk.size());
+
+			//Every row starts with filter type 0
+			const size_t rowSize{ size_t(width) * 3 };
+			std::vector<uint8_t> filtered(height * (rowSize + 1));
+			for (int y{}; y < height; ++y)
+				memcpy(filtered.data() + y * (rowSize + 1) + 1, rgb.data() + y * rowSize, rowSize);
+
+			//zlib stream made of stored deflate blocks
+			static constexpr size_t MAX_BLOCK_SIZE{ 65535 };
+			chunk.clear();
+			chunk.push_back(0x78);
+			chunk.push_back(0x01);
+			for (size_t offset{}; offset < filtered.size(); offset += MAX_BLOCK_SIZE)
+			{
+				const size_t blockSize{ std::min(MAX_BLOCK_SIZE, filtered.size() - offset) };
+				chunk.push_back(offset + blockSize == filtered.size() ? 1 : 0);
+				AppendLittleEndian(chunk, static_cast<uint32_t>(blockSize), 2);
+				AppendLittleEndian(chunk, static_cast<uint32_t>(~blockSize), 2);
+				AppendBytes(chunk, filtered.data() + offset, blockSize);
+			}
+			uint32_t a{ 1 }, b{};
+			for (uint8_t value : filtered)
+			{
+				a = (a + value) % 65521;
+				b = (b + a) % 65521;
+			}
+			AppendBigEndian(chunk, (b << 16) | a);
+			AppendPngChunk(out, "IDAT", chunk.data(), chunk.size());
+			AppendPngChunk(out, "IEND", nullptr, 0);
+		}
+	}
+
+	FrameWriter::FrameWriter(const std::string& pattern, int width, int height, uint32_t firstFrameNumber, size_t queueCapacity) :
+		m_Pattern{ pattern },
+		m_Width{ width },
+		m_Height{ height },
+		m_FirstFrameNumber{ firstFrameNumber },
+		m_NextFrameNumber{ firstFrameNumber }
+	{
+		const std::filesystem::path path{ pattern };
+		std::string extension{ path.extension().string() };
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+		if (pattern == "-" || extension == ".raw") m_Format = Format::Raw;
+		else if (extension == ".bmp") m_Format = Format::BMP;
+		else if (extension == ".png") m_Format = Format::PNG;
+		else m_Format = Format::PPM;
+
+		if (pattern == "-")
+		{
+#if defined(_WIN32)
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			m_pStream = stdout;
+		}
+		else
+		{
+			std::error_code error{};
+			if (path.has_parent_path())
+				std::filesystem::create_directories(path.parent_path(), error);
+			if (m_Format == Format::Raw)
+				m_pStream = std::fopen(pattern.c_str(), firstFrameNumber > 0 ? "ab" : "wb");
+		}
+
+		m_Slots.resize(std::max<size_t>(queueCapacity, 1));
+		for (size_t slotIndex{}; slotIndex < m_Slots.size(); ++slotIndex)
+		{
+			m_Slots[slotIndex].pixels.resize(size_t(width) * height);
+			m_FreeSlots.push_back(slotIndex);
+		}
+
+		//A stream has to stay in order, image files can be encoded in parallel. Leave most cores to the renderer
+		const unsigned workerCount{ IsStream() ? 1 : std::max(1u, std::thread::hardware_concurrency() / 4) };
+		for (unsigned workerIndex{}; workerIndex < workerCount; ++workerIndex)
+			m_Workers.emplace_back(&FrameWriter::WorkerLoop, this);
+	}
+
+	FrameWriter::~FrameWriter()
+	{
+		//Everything submitted is still written
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_FrameQueued.notify_all();
+		for (std::thread& worker : m_Workers)
+			worker.join();
+
+		if (m_pStream == stdout)
+			std::fflush(m_pStream);
+		else if (m_pStream)
+			std::fclose(m_pStream);
+	}
+
+	void FrameWriter::Submit(const SDL_Surface* pSurface)
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_SlotFreed.wait(lock, [this] { return !m_FreeSlots.empty(); });
+		const size_t slotIndex{ m_FreeSlots.front() };
+		m_FreeSlots.pop_front();
+		lock.unlock();
+
+		//The copy is the only work done on the render thread
+		Slot& slot{ m_Slots[slotIndex] };
+		const int width{ std::min(m_Width, pSurface->w) };
+		for (int y{}; y < std::min(m_Height, pSurface->h); ++y)
+		{
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pSurface->pixels) + size_t(y) * pSurface->pitch };
+			memcpy(slot.pixels.data() + size_t(y) * m_Width, pRow, width * sizeof(uint32_t));
+		}
+		slot.redShift = pSurface->format->Rshift;
+		slot.greenShift = pSurface->format->Gshift;
+		slot.blueShift = pSurface->format->Bshift;
+
+		lock.lock();
+		slot.frameNumber = m_NextFrameNumber++;
+		m_QueuedSlots.push_back(slotIndex);
+		lock.unlock();
+		m_FrameQueued.notify_one();
+	}
+
+	void FrameWriter::Flush()
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_SlotFreed.wait(lock, [this] { return m_FreeSlots.size() == m_Slots.size(); });
+		if (m_pStream)
+			std::fflush(m_pStream);
+	}
+
+	uint32_t FrameWriter::GetFailedFrameCount() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+		return m_FailedFrameCount;
+	}
+
+	void FrameWriter::WorkerLoop()
+	{
+		//Reused for every frame this worker writes
+		std::vector<uint8_t> rgb{}, encoded{};
+		while (true)
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_FrameQueued.wait(lock, [this] { return m_IsStopping || !m_QueuedSlots.empty(); });
+			if (m_QueuedSlots.empty())
+				return;
+			const size_t slotIndex{ m_QueuedSlots.front() };
+			m_QueuedSlots.pop_front();
+			lock.unlock();
+
+			const bool isWritten{ WriteFrame(m_Slots[slotIndex], rgb, encoded) };
+
+			lock.lock();
+			if (!isWritten)
+				++m_FailedFrameCount;
+			m_FreeSlots.push_back(slotIndex);
+			lock.unlock();
+			m_SlotFreed.notify_all();
+		}
+	}
+
+	bool FrameWriter::WriteFrame(const Slot& slot, std::vector<uint8_t>& rgb, std::vector<uint8_t>& encoded) const
+	{
+		rgb.clear();
+		for (uint32_t pixel : slot.pixels)
+		{
+			rgb.push_back(static_cast<uint8_t>(pixel >> slot.redShift));
+			rgb.push_back(static_cast<uint8_t>(pixel >> slot.greenShift));
+			rgb.push_back(static_cast<uint8_t>(pixel >> slot.blueShift));
+		}
+
+		if (m_Format == Format::Raw)
+			return m_pStream && std::fwrite(rgb.data(), 1, rgb.size(), m_pStream) == rgb.size();
+
+		encoded.clear();
+		switch (m_Format)
+		{
+		case Format::PPM: EncodePPM(rgb, m_Width, m_Height, encoded); break;
+		case Format::BMP: EncodeBMP(rgb, m_Width, m_Height, encoded); break;
+		case Format::PNG: EncodePNG(rgb, m_Width, m_Height, encoded); break;
+		default: break;
+		}
+
+		std::ofstream file{ GetFramePath(slot.frameNumber), std::ios::binary };
+		file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+		return file.good();
+	}
+
+	std::string FrameWriter::GetFramePath(uint32_t frameNumber) const
+	{
+		//Without '#' the number goes in front of the extension
+		std::string path{ m_Pattern };
+		size_t first{ path.find('#') };
+		size_t count{};
+		if (first == std::string::npos)
+		{
+			const size_t dot{ path.find_last_of('.') };
+			const size_t slash{ path.find_last_of("/\\") };
+			first = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : path.size();
+			path.insert(first, "_");
+			++first;
+		}
+		else
+		{
+			while (first + count < path.size() && path[first + count] == '#')
+				++count;
+			path.erase(first, count);
+		}
+
+		const size_t digitCount{ count > 0 ? count : 5 };
+		std::string number{ std::to_string(frameNumber) };
+		if (number.size() < digitCount)
+			number.insert(0, digitCount - number.size(), '0');
+		path.insert(first, number);
+		return path;
+	}
+}
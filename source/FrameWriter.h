@@ -0,0 +1,85 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SDL_Surface;
+
+namespace dae
+{
+	//Writes rendered frames as an image sequence on background threads. Frames are copied into a fixed number of
+	//slots, the render thread only waits when every slot is still waiting to be encoded
+	class FrameWriter final
+	{
+	public:
+		enum class Format
+		{
+			PPM,
+			BMP,
+			PNG, //Stored deflate blocks, there is no compressor in the project
+			Raw //Headerless 8 bit RGB, one frame after the other, to feed a video encoder
+		};
+
+		/**
+		 * \param pattern output path, the first run of '#' is replaced by the zero padded frame number and
+		 * the extension selects the format. "-" streams raw frames to stdout, any other .raw path (a named pipe for example)
+		 * receives the raw stream as one file
+		 * \param firstFrameNumber number of the first submitted frame, a later recording to the same pattern continues
+		 * the sequence instead of overwriting it and a raw file is appended to
+		 * \param queueCapacity frames that can be waiting for a writer before Submit blocks
+		 */
+		FrameWriter(const std::string& pattern, int width, int height, uint32_t firstFrameNumber = 0, size_t queueCapacity = 8);
+		~FrameWriter();
+
+		FrameWriter(const FrameWriter&) = delete;
+		FrameWriter(FrameWriter&&) noexcept = delete;
+		FrameWriter& operator=(const FrameWriter&) = delete;
+		FrameWriter& operator=(FrameWriter&&) noexcept = delete;
+
+		//Queues a copy of the surface as the next frame
+		void Submit(const SDL_Surface* pSurface);
+		//Blocks until every submitted frame is written
+		void Flush();
+
+		bool IsStream() const { return m_Format == Format::Raw; }
+		uint32_t GetSubmittedFrameCount() const { return m_NextFrameNumber - m_FirstFrameNumber; }
+		uint32_t GetNextFrameNumber() const { return m_NextFrameNumber; }
+		uint32_t GetFailedFrameCount() const;
+
+	private:
+		struct Slot
+		{
+			std::vector<uint32_t> pixels{};
+			uint32_t frameNumber{};
+			uint32_t redShift{}, greenShift{}, blueShift{};
+		};
+
+		std::string m_Pattern{};
+		Format m_Format{};
+		int m_Width{};
+		int m_Height{};
+
+		std::vector<Slot> m_Slots{};
+		std::deque<size_t> m_FreeSlots{};
+		std::deque<size_t> m_QueuedSlots{};
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_SlotFreed{};
+		std::condition_variable m_FrameQueued{};
+		bool m_IsStopping{};
+		uint32_t m_FirstFrameNumber{};
+		uint32_t m_NextFrameNumber{};
+		uint32_t m_FailedFrameCount{};
+
+		std::FILE* m_pStream{};
+		std::vector<std::thread> m_Workers{};
+
+		void WorkerLoop();
+		bool WriteFrame(const Slot& slot, std::vector<uint8_t>& rgb, std::vector<uint8_t>& encoded) const;
+		std::string GetFramePath(uint32_t frameNumber) const;
+	};
+}
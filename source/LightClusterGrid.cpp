@@ -0,0 +1,146 @@
+#include "LightClusterGrid.h"
+#include "DataTypes.h"
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+namespace dae
+{
+	namespace
+	{
+		struct ClusterBounds
+		{
+			Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			void Grow(const Vector3& point)
+			{
+				min = Vector3::Min(min, point);
+				max = Vector3::Max(max, point);
+			}
+
+			bool IsEmpty() const { return min.x > max.x; }
+
+			bool OverlapsSphere(const Vector3& center, float radius) const
+			{
+				float sqrDistance{ 0.f };
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					if (center[axis] < min[axis]) sqrDistance += Square(min[axis] - center[axis]);
+					else if (center[axis] > max[axis]) sqrDistance += Square(center[axis] - max[axis]);
+				}
+				return sqrDistance <= radius * radius;
+			}
+		};
+	}
+
+	void LightClusterGrid::Build(const std::vector<Light>& lights, const std::vector<HitRecord>& primaryHits, int width, int height)
+	{
+		Prepare(lights, width, height);
+		std::for_each(std::execution::par, m_TileIndices.begin(), m_TileIndices.end(), [&](uint32_t tileIndex)
+			{
+				BuildTile(tileIndex, lights, primaryHits, height);
+			});
+	}
+
+	void LightClusterGrid::Prepare(const std::vector<Light>& lights, int width, int height)
+	{
+		m_GlobalLights.clear();
+		m_BoundedLights.clear();
+		for (uint32_t i = 0; i < static_cast<uint32_t>(lights.size()); ++i)
+		{
+			if (lights[i].type == LightType::Point && lights[i].influenceRadius > 0.f)
+				m_BoundedLights.push_back(i);
+			else
+				m_GlobalLights.push_back(i);
+		}
+
+		m_Width = width;
+		m_TilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		const size_t tileCount{ size_t(m_TilesX) * ((height + TILE_SIZE - 1) / TILE_SIZE) };
+		if (m_Tiles.size() != tileCount)
+		{
+			m_Tiles.resize(tileCount);
+			m_TileIndices.resize(tileCount);
+			std::iota(m_TileIndices.begin(), m_TileIndices.end(), 0);
+		}
+		m_PixelSlices.resize(size_t(width) * height);
+	}
+
+	std::span<const uint32_t> LightClusterGrid::GetLights(uint32_t pixelIndex) const
+	{
+		const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+		const Tile& tile{ m_Tiles[(py / TILE_SIZE) * m_TilesX + px / TILE_SIZE] };
+		const uint8_t slice{ m_PixelSlices[pixelIndex] };
+		return { tile.lightIndices.data() + tile.sliceOffsets[slice], tile.sliceOffsets[slice + 1] - tile.sliceOffsets[slice] };
+	}
+
+	void LightClusterGrid::BuildTile(uint32_t tileIndex, const std::vector<Light>& lights, const std::vector<HitRecord>& primaryHits, int height)
+	{
+		Tile& tile{ m_Tiles[tileIndex] };
+		tile.lightIndices.clear();
+		std::fill(std::begin(tile.sliceOffsets), std::end(tile.sliceOffsets), 0);
+
+		const int firstX{ int(tileIndex % m_TilesX) * TILE_SIZE };
+		const int firstY{ int(tileIndex / m_TilesX) * TILE_SIZE };
+		const int lastX{ std::min(firstX + TILE_SIZE, m_Width) };
+		const int lastY{ std::min(firstY + TILE_SIZE, height) };
+
+		float minDepth{ FLT_MAX }, maxDepth{ 0.f };
+		for (int py = firstY; py < lastY; ++py)
+		{
+			for (int px = firstX; px < lastX; ++px)
+			{
+				const HitRecord& hit{ primaryHits[px + py * m_Width] };
+				if (!hit.didHit) continue;
+				minDepth = std::min(minDepth, hit.t);
+				maxDepth = std::max(maxDepth, hit.t);
+			}
+		}
+		if (minDepth > maxDepth) return;
+
+		//Logarithmic slices keep the clusters close to the camera small
+		const float sliceScale{ maxDepth > minDepth ? DEPTH_SLICES / logf(maxDepth / minDepth) : 0.f };
+		ClusterBounds sliceBounds[DEPTH_SLICES]{};
+		ClusterBounds tileBounds{};
+		for (int py = firstY; py < lastY; ++py)
+		{
+			for (int px = firstX; px < lastX; ++px)
+			{
+				const uint32_t pixelIndex{ uint32_t(px + py * m_Width) };
+				const HitRecord& hit{ primaryHits[pixelIndex] };
+				if (!hit.didHit) continue;
+				const int slice{ std::min(DEPTH_SLICES - 1, int(logf(hit.t / minDepth) * sliceScale)) };
+				m_PixelSlices[pixelIndex] = static_cast<uint8_t>(slice);
+				sliceBounds[slice].Grow(hit.origin);
+				tileBounds.Grow(hit.origin);
+			}
+		}
+
+		//Reject against the whole tile first, most lights miss most tiles
+		FrameArena& arena{ FrameArena::Get() };
+		const FrameArena::Scope arenaScope{ arena };
+		uint32_t* const pCandidates{ arena.Allocate<uint32_t>(m_BoundedLights.size()) };
+		size_t candidateCount{};
+		for (uint32_t lightIndex : m_BoundedLights)
+		{
+			if (tileBounds.OverlapsSphere(lights[lightIndex].origin, lights[lightIndex].influenceRadius))
+				pCandidates[candidateCount++] = lightIndex;
+		}
+		const std::span<const uint32_t> candidates{ pCandidates, candidateCount };
+
+		for (int slice = 0; slice < DEPTH_SLICES; ++slice)
+		{
+			tile.sliceOffsets[slice] = static_cast<uint32_t>(tile.lightIndices.size());
+			if (sliceBounds[slice].IsEmpty()) continue;
+			for (uint32_t lightIndex : candidates)
+			{
+				if (sliceBounds[slice].OverlapsSphere(lights[lightIndex].origin, lights[lightIndex].influenceRadius))
+					tile.lightIndices.push_back(lightIndex);
+			}
+		}
+		tile.sliceOffsets[DEPTH_SLICES] = static_cast<uint32_t>(tile.lightIndices.size());
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Light;
+	struct HitRecord;
+
+	//Screen space tiles split into depth slices, every cluster lists the bounded point lights that can reach its surface points.
+	//Built after the primary rays so the cluster bounds come from the actual hit positions instead of frustum slices
+	class LightClusterGrid final
+	{
+	public:
+		static constexpr int TILE_SIZE{ 16 };
+		static constexpr int DEPTH_SLICES{ 16 };
+
+		LightClusterGrid() = default;
+		~LightClusterGrid() = default;
+
+		LightClusterGrid(const LightClusterGrid&) = delete;
+		LightClusterGrid(LightClusterGrid&&) noexcept = delete;
+		LightClusterGrid& operator=(const LightClusterGrid&) = delete;
+		LightClusterGrid& operator=(LightClusterGrid&&) noexcept = delete;
+
+		/**
+		 * \brief Assigns the lights to the clusters
+		 * \param lights scene lights, point lights with an influence radius get culled, all others are global
+		 * \param primaryHits closest hit of every pixel, row major
+		 */
+		void Build(const std::vector<Light>& lights, const std::vector<HitRecord>& primaryHits, int width, int height);
+		//Build split up for images that are traced tile by tile. Prepare once, then build every tile once its primary hits are in,
+		//tiles can be built in parallel
+		void Prepare(const std::vector<Light>& lights, int width, int height);
+		void BuildTile(uint32_t tileIndex, const std::vector<Light>& lights, const std::vector<HitRecord>& primaryHits, int height);
+
+		//Bounded point lights that can reach the surface seen through pixelIndex
+		std::span<const uint32_t> GetLights(uint32_t pixelIndex) const;
+		//Directional and unbounded point lights, these reach every pixel
+		const std::vector<uint32_t>& GetGlobalLights() const { return m_GlobalLights; }
+
+	private:
+		struct Tile
+		{
+			std::vector<uint32_t> lightIndices{}; //Grouped per slice
+			uint32_t sliceOffsets[DEPTH_SLICES + 1]{};
+		};
+
+		int m_Width{};
+		int m_TilesX{};
+		std::vector<Tile> m_Tiles{};
+		std::vector<uint32_t> m_TileIndices{};
+		std::vector<uint8_t> m_PixelSlices{};
+
+		std::vector<uint32_t> m_GlobalLights{};
+		std::vector<uint32_t> m_BoundedLights{};
+	};
+}
@@ -0,0 +1,154 @@
+#include "LightTree.h"
+#include "DataTypes.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		//Keeps u strictly below 1 after rescaling
+		constexpr float ONE_MINUS_EPSILON{ 0x1.fffffep-1f };
+
+		//Avoids infinite importance when a point light sits on the shaded surface
+		constexpr float MIN_SQUARED_DISTANCE{ 1e-4f };
+	}
+
+	void LightTree::Build(const std::vector<Light>& lights)
+	{
+		m_Nodes.clear();
+		m_DirectionalLights.clear();
+
+		std::vector<uint32_t> pointLights{};
+		for (uint32_t i = 0; i < static_cast<uint32_t>(lights.size()); ++i)
+		{
+			if (lights[i].type != LightType::Directional)
+				pointLights.push_back(i);
+			else
+				m_DirectionalLights.push_back(i);
+		}
+		if (pointLights.empty()) return;
+
+		//One light per leaf, a full binary tree has 2n - 1 nodes
+		m_Nodes.reserve(pointLights.size() * 2 - 1);
+		m_Nodes.emplace_back();
+
+		struct PendingNode
+		{
+			uint32_t nodeIndex;
+			uint32_t first;
+			uint32_t count;
+		};
+		std::vector<PendingNode> stack{ { 0, 0, static_cast<uint32_t>(pointLights.size()) } };
+		while (!stack.empty())
+		{
+			const PendingNode pending{ stack.back() };
+			stack.pop_back();
+
+			if (pending.count == 1)
+			{
+				m_Nodes[pending.nodeIndex].lightIndex = pointLights[pending.first];
+				continue;
+			}
+
+			//Median split along the largest axis of the light positions
+			Vector3 minPosition{ lights[pointLights[pending.first]].origin };
+			Vector3 maxPosition{ minPosition };
+			for (uint32_t i = pending.first + 1; i < pending.first + pending.count; ++i)
+			{
+				minPosition = Vector3::Min(minPosition, lights[pointLights[i]].origin);
+				maxPosition = Vector3::Max(maxPosition, lights[pointLights[i]].origin);
+			}
+			const Vector3 extent{ maxPosition - minPosition };
+			const int axis{ (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2) };
+
+			const uint32_t leftCount{ pending.count / 2 };
+			const auto firstIt{ pointLights.begin() + pending.first };
+			std::nth_element(firstIt, firstIt + leftCount, firstIt + pending.count,
+				[&](uint32_t a, uint32_t b) { return lights[a].origin[axis] < lights[b].origin[axis]; });
+
+			const uint32_t leftIndex{ static_cast<uint32_t>(m_Nodes.size()) };
+			m_Nodes.emplace_back();
+			m_Nodes.emplace_back();
+			m_Nodes[pending.nodeIndex].leftChild = leftIndex;
+
+			stack.push_back({ leftIndex, pending.first, leftCount });
+			stack.push_back({ leftIndex + 1, pending.first + leftCount, pending.count - leftCount });
+		}
+
+		//Children are stored after their parent, walking backwards visits them first
+		for (size_t i = m_Nodes.size(); i-- > 0;)
+		{
+			Node& node{ m_Nodes[i] };
+			if (node.leftChild == 0)
+			{
+				const Light& light{ lights[node.lightIndex] };
+				const Vector3 halfExtent{ LightUtils::GetHalfExtent(light) };
+				node.minAABB = light.origin - halfExtent;
+				node.maxAABB = light.origin + halfExtent;
+				node.power = std::max(0.f, light.intensity * light.color.GetLuminance());
+			}
+			else
+			{
+				const Node& left{ m_Nodes[node.leftChild] };
+				const Node& right{ m_Nodes[node.leftChild + 1] };
+				node.minAABB = Vector3::Min(left.minAABB, right.minAABB);
+				node.maxAABB = Vector3::Max(left.maxAABB, right.maxAABB);
+				node.power = left.power + right.power;
+			}
+		}
+	}
+
+	bool LightTree::Sample(const Vector3& position, const Vector3& normal, float u, uint32_t& lightIndex, float& pdf) const
+	{
+		if (m_Nodes.empty()) return false;
+
+		pdf = 1.f;
+		uint32_t nodeIndex{ 0 };
+		while (m_Nodes[nodeIndex].leftChild != 0)
+		{
+			const uint32_t leftChild{ m_Nodes[nodeIndex].leftChild };
+			const float leftImportance{ GetImportance(m_Nodes[leftChild], position, normal) };
+			const float rightImportance{ GetImportance(m_Nodes[leftChild + 1], position, normal) };
+			const float totalImportance{ leftImportance + rightImportance };
+			if (totalImportance <= 0.f) return false;
+
+			//Reuse u for the next level by rescaling the chosen interval back to [0, 1)
+			const float leftProbability{ leftImportance / totalImportance };
+			if (u < leftProbability)
+			{
+				nodeIndex = leftChild;
+				pdf *= leftProbability;
+				u /= leftProbability;
+			}
+			else
+			{
+				nodeIndex = leftChild + 1;
+				pdf *= 1.f - leftProbability;
+				u = (u - leftProbability) / (1.f - leftProbability);
+			}
+			u = std::min(u, ONE_MINUS_EPSILON);
+		}
+
+		lightIndex = m_Nodes[nodeIndex].lightIndex;
+		return true;
+	}
+
+	float LightTree::GetImportance(const Node& node, const Vector3& position, const Vector3& normal)
+	{
+		const Vector3 center{ (node.minAABB + node.maxAABB) * 0.5f };
+		const Vector3 halfExtent{ (node.maxAABB - node.minAABB) * 0.5f };
+		const Vector3 toCenter{ center - position };
+
+		//Farthest the box reaches along the normal, negative when every light is behind the surface
+		const float maxHeight{ Vector3::Dot(toCenter, normal) +
+			halfExtent.x * std::abs(normal.x) + halfExtent.y * std::abs(normal.y) + halfExtent.z * std::abs(normal.z) };
+		if (maxHeight < 0.f) return 0.f;
+
+		//Inside or close to the box the distance to its center says little, clamp to its size instead
+		const float squaredDistance{ std::max({ toCenter.SqrMagnitude(), halfExtent.SqrMagnitude(), MIN_SQUARED_DISTANCE }) };
+		return node.power / squaredDistance;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Light;
+
+	//Binary hierarchy over the point and area lights of a scene, every node stores the bounds and summed power of its lights.
+	//Used to pick a light in proportion to its estimated contribution so the shading cost no longer grows with the light count
+	class LightTree final
+	{
+	public:
+		LightTree() = default;
+		~LightTree() = default;
+
+		LightTree(const LightTree&) = delete;
+		LightTree(LightTree&&) noexcept = delete;
+		LightTree& operator=(const LightTree&) = delete;
+		LightTree& operator=(LightTree&&) noexcept = delete;
+
+		void Build(const std::vector<Light>& lights);
+
+		/**
+		 * \brief Walks the tree choosing children by their importance for the shaded point
+		 * \param normal surface normal, lights entirely behind the surface are skipped. Pass a zero vector to ignore the orientation
+		 * \param u uniform random number in [0, 1)
+		 * \param lightIndex index into the lights the tree was built from
+		 * \param pdf probability of having picked lightIndex
+		 * \return false if no light in the tree can contribute
+		 */
+		bool Sample(const Vector3& position, const Vector3& normal, float u, uint32_t& lightIndex, float& pdf) const;
+
+		//Directional lights have no position to bound, they are always evaluated
+		const std::vector<uint32_t>& GetDirectionalLights() const { return m_DirectionalLights; }
+		size_t GetPointLightCount() const { return m_Nodes.empty() ? 0 : (m_Nodes.size() + 1) / 2; }
+
+	private:
+		struct Node
+		{
+			Vector3 minAABB{};
+			float power{};
+			Vector3 maxAABB{};
+			uint32_t leftChild{}; //0 for leaves (the root is never a child), the right child is leftChild + 1
+			uint32_t lightIndex{}; //Leaves only
+		};
+
+		std::vector<Node> m_Nodes{};
+		std::vector<uint32_t> m_DirectionalLights{};
+
+		static float GetImportance(const Node& node, const Vector3& position, const Vector3& normal);
+	};
+}
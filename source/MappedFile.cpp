@@ -0,0 +1,217 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <utility>
+
+using namespace dae;
+
+MappedFile::MappedFile(const std::string& filename)
+{
+	Open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this == &other) return *this;
+
+	Close();
+	std::swap(m_pData, other.m_pData);
+	std::swap(m_Size, other.m_Size);
+	std::swap(m_IsOpen, other.m_IsOpen);
+	std::swap(m_IsWritable, other.m_IsWritable);
+#if defined(_WIN32)
+	std::swap(m_FileHandle, other.m_FileHandle);
+	std::swap(m_MappingHandle, other.m_MappingHandle);
+#else
+	std::swap(m_FileDescriptor, other.m_FileDescriptor);
+#endif
+	return *this;
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_Size = static_cast<size_t>(fileSize.QuadPart);
+	m_IsOpen = true;
+
+	//Mapping an empty file is not allowed, an open file without data is still valid
+	if (m_Size == 0) return true;
+
+	m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_MappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = static_cast<char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+#else
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat fileStat {};
+	if (fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	m_FileDescriptor = fd;
+	m_Size = static_cast<size_t>(fileStat.st_size);
+	m_IsOpen = true;
+
+	if (m_Size == 0) return true;
+
+	void* pMapping = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (pMapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	madvise(pMapping, m_Size, MADV_SEQUENTIAL);
+	m_pData = static_cast<char*>(pMapping);
+#endif
+	return true;
+}
+
+bool MappedFile::Create(const std::string& filename, size_t size)
+{
+	Close();
+	if (size == 0) return false;
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	m_FileHandle = file;
+	m_Size = size;
+	m_IsOpen = true;
+
+	//The mapping grows the file to its size
+	const unsigned long long mappingSize{ size };
+	m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize & 0xFFFFFFFF), nullptr);
+	if (!m_MappingHandle)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = static_cast<char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_WRITE, 0, 0, 0));
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+#else
+	const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return false;
+
+	m_FileDescriptor = fd;
+	m_Size = size;
+	m_IsOpen = true;
+
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* pMapping = mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (pMapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_pData = static_cast<char*>(pMapping);
+#endif
+	m_IsWritable = true;
+	return true;
+}
+
+void MappedFile::Release(size_t offset, size_t size) const
+{
+	if (!m_IsWritable || offset >= m_Size) return;
+	size = std::min(size, m_Size - offset);
+
+#if defined(_WIN32)
+	SYSTEM_INFO systemInfo{};
+	GetSystemInfo(&systemInfo);
+	const size_t pageSize{ systemInfo.dwPageSize };
+#else
+	const size_t pageSize{ static_cast<size_t>(sysconf(_SC_PAGESIZE)) };
+#endif
+	//The page the range ends in can still be shared with data that is being written, it goes with the next range
+	const size_t first{ offset / pageSize * pageSize };
+	const size_t last{ (offset + size) / pageSize * pageSize };
+	if (first >= last) return;
+
+#if defined(_WIN32)
+	FlushViewOfFile(m_pData + first, last - first);
+	//Unlocking pages that are not locked removes them from the working set
+	VirtualUnlock(m_pData + first, last - first);
+#else
+	//Dirty pages of a shared mapping stay in the page cache and are written back from there
+	madvise(m_pData + first, last - first, MADV_DONTNEED);
+#endif
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_MappingHandle) CloseHandle(m_MappingHandle);
+	if (m_FileHandle) CloseHandle(m_FileHandle);
+	m_MappingHandle = nullptr;
+	m_FileHandle = nullptr;
+#else
+	if (m_pData) munmap(m_pData, m_Size);
+	if (m_FileDescriptor >= 0) close(m_FileDescriptor);
+	m_FileDescriptor = -1;
+#endif
+	m_pData = nullptr;
+	m_Size = 0;
+	m_IsOpen = false;
+	m_IsWritable = false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Memory mapping of a file on disk, read-only unless it was created through Create
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& filename);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		bool Open(const std::string& filename);
+		//Creates or truncates filename to size bytes and maps it writable
+		bool Create(const std::string& filename, size_t size);
+		void Close();
+
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		//Null unless the file was created writable
+		char* GetWritableData() const { return m_IsWritable ? m_pData : nullptr; }
+		size_t GetSize() const { return m_Size; }
+
+		//Hands a written range to the system to write back and drops it from this process' memory, so writing a file
+		//much larger than memory only keeps the part in progress resident. Ranges have to be released front to back
+		void Release(size_t offset, size_t size) const;
+
+	private:
+		char* m_pData{ nullptr };
+		size_t m_Size{};
+		bool m_IsOpen{ false };
+		bool m_IsWritable{ false };
+
+#if defined(_WIN32)
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+#else
+		int m_FileDescriptor{ -1 };
+#endif
+	};
+}
@@ -5,17 +5,42 @@
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+	enum class MaterialType : uint8_t
+	{
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence,
+		Dielectric //Smooth glass, reflects and refracts
+	};
+
+	//Direction a secondary ray leaves a hit in and the share of the light arriving along it that reaches the viewer
+	struct MaterialBounce
+	{
+		Vector3 direction{};
+		ColorRGB weight{};
+	};
+
+	//Parameters of one material, stored by value in the scene's material pool and indexed by MaterialId.
+	//One cache line each, everything that only depends on the parameters is computed when the material is created
+	class alignas(64) Material final
 	{
 	public:
 		Material() = default;
-		virtual ~Material() = default;
 
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
+		static Material CreateSolidColor(const ColorRGB& color);
+		static Material CreateLambert(const ColorRGB& diffuseColor, float diffuseReflectance);
+		static Material CreateLambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent);
+		/**
+		 * \param metalness 1 for conductors, anything else is treated as a dielectric
+		 * \param roughness [1.0 > 0.0] >> [ROUGH > SMOOTH]
+		 */
+		static Material CreateCookTorrence(const ColorRGB& albedo, float metalness, float roughness);
+		/**
+		 * \param transmittance tint of the light passing through a surface
+		 * \param indexOfRefraction 1.5 for glass, 1.33 for water
+		 */
+		static Material CreateDielectric(const ColorRGB& transmittance, float indexOfRefraction);
 
 		/**
 		 * \brief Function used to calculate the correct color for the specific material and its parameters
@@ -24,115 +49,204 @@ namespace dae
 		 * \param v view direction
 		 * \return color
 		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
-	};
-#pragma endregion
-
-#pragma region Material SOLID COLOR
-	//SOLID COLOR
-	//===========
-	class Material_SolidColor final : public Material
-	{
-	public:
-		Material_SolidColor(const ColorRGB& color) : m_Color(color)
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
+			switch (m_Type)
+			{
+			case MaterialType::SolidColor:
+				return m_Color;
+			case MaterialType::Lambert:
+				return m_Diffuse;
+			case MaterialType::LambertPhong:
+				return m_Diffuse + BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
+			case MaterialType::CookTorrence:
+				return ShadeCookTorrence(hitRecord, l, v);
+			case MaterialType::Dielectric:
+				//Only the highlight, the rest of what glass shows comes from its secondary rays
+				return ShadeSpecular(hitRecord, l, v);
+			}
+			return {};
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		/**
+		 * \brief Secondary rays of a hit, only CookTorrence (specular reflection) and Dielectric materials have any
+		 * \param v view direction, pointing away from the surface like in Shade
+		 * \param u1, u2 uniform random numbers in [0, 1), pick the reflection direction of rough surfaces
+		 * \return number of bounces written, at most 2
+		 */
+		int GetBounces(const HitRecord& hitRecord, const Vector3& v, float u1, float u2, MaterialBounce (&bounces)[2]) const
 		{
-			return m_Color;
+			switch (m_Type)
+			{
+			case MaterialType::CookTorrence:
+			{
+				//Importance sampled GGX lobe, the weight is the BRDF times the cosine over the density of the half vector
+				const Vector3& n{ hitRecord.normal };
+				const Vector3 h{ BRDF::SampleHalfVector_GGX(n, m_Alpha4, u1, u2) };
+				const float vhDot{ Vector3::Dot(v, h) };
+				const Vector3 l{ 2.f * vhDot * h - v };
+				const float vnDot{ Vector3::Dot(v, n) }, lnDot{ Vector3::Dot(l, n) }, nhDot{ Vector3::Dot(n, h) };
+				if (vhDot <= 0.f || vnDot <= 0.f || lnDot <= 0.f || nhDot <= 0.f)
+					return 0;
+
+				const ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(h, v, m_F0) };
+				const float geometry{ BRDF::GeometryFunction_Smith(n, v, l, m_SchlickK) };
+				bounces[0] = { l, fresnel * (geometry * vhDot / (vnDot * nhDot)) };
+				return 1;
+			}
+			case MaterialType::Dielectric:
+			{
+				//Leaving the medium when the view is on the inside of the normal
+				Vector3 n{ hitRecord.normal };
+				float cosIncident{ Vector3::Dot(v, n) };
+				float eta{ 1.f / m_IndexOfRefraction };
+				if (cosIncident < 0.f)
+				{
+					n = -n;
+					cosIncident = -cosIncident;
+					eta = m_IndexOfRefraction;
+				}
+				const Vector3 reflected{ 2.f * cosIncident * n - v };
+
+				const float sinTransmittedSqr{ eta * eta * (1.f - cosIncident * cosIncident) };
+				if (sinTransmittedSqr >= 1.f)
+				{
+					//Total internal reflection
+					bounces[0] = { reflected, colors::White };
+					return 1;
+				}
+				const float cosTransmitted{ sqrtf(1.f - sinTransmittedSqr) };
+				const float reflectance{ BRDF::Fresnel_Dielectric(cosIncident, cosTransmitted, eta) };
+				bounces[0] = { reflected, ColorRGB{ reflectance, reflectance, reflectance } };
+				bounces[1] = { (-eta * v + (eta * cosIncident - cosTransmitted) * n).Normalized(), m_Color * (1.f - reflectance) };
+				return 2;
+			}
+			default:
+				return 0;
+			}
 		}
 
-	private:
-		ColorRGB m_Color{ colors::White };
-	};
-#pragma endregion
-
-#pragma region Material LAMBERT
-	//LAMBERT
-	//=======
-	class Material_Lambert final : public Material
-	{
-	public:
-		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance) {}
-
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		/**
+		 * \brief Cosine distributed bounce of the diffuse part, what GetBounces leaves out. Phong highlights are only lit directly
+		 * \param v view direction, pointing away from the surface like in Shade
+		 * \param u1, u2 uniform random numbers in [0, 1)
+		 * \return false for materials without a diffuse part
+		 */
+		bool GetDiffuseBounce(const HitRecord& hitRecord, const Vector3& v, float u1, float u2, MaterialBounce& bounce) const
 		{
-			//todo: W3
-			//assert(false && "Not Implemented Yet");
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			//The density cancels the cosine and the 1 / PI of the Lambert term
+			const Vector3 l{ BRDF::SampleDirection_Cosine(hitRecord.normal, u1, u2) };
+			switch (m_Type)
+			{
+			case MaterialType::Lambert:
+			case MaterialType::LambertPhong:
+				bounce = { l, m_Diffuse * PI };
+				return true;
+			case MaterialType::CookTorrence:
+			{
+				if (m_IsMetal) return false;
+				ColorRGB kd{ colors::White };
+				kd -= ShadeSpecular(hitRecord, l, v);
+				kd *= m_Color;
+				bounce = { l, kd };
+				return true;
+			}
+			default:
+				return false;
+			}
 		}
 
 	private:
-		ColorRGB m_DiffuseColor{ colors::White };
-		float m_DiffuseReflectance{ 1.f }; //kd
-	};
-#pragma endregion
-
-#pragma region Material LAMBERT PHONG
-	//LAMBERT-PHONG
-	//=============
-	class Material_LambertPhong final : public Material
-	{
-	public:
-		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
-			m_PhongExponent(phongExponent)
-		{
-		}
-
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB m_Color{ colors::White }; //Solid color, diffuse color or albedo depending on the type
+		ColorRGB m_Diffuse{}; //Lambert term of Lambert and LambertPhong
+		ColorRGB m_F0{}; //Base reflectivity of CookTorrence
+		float m_SpecularReflectance{}; //ks
+		float m_PhongExponent{};
+		float m_Alpha4{}; //roughness^4, GGX distribution term
+		float m_SchlickK{}; //Direct lighting k of the SchlickGGX geometry term
+		float m_IndexOfRefraction{}; //Dielectric
+		MaterialType m_Type{ MaterialType::SolidColor };
+		bool m_IsMetal{};
+
+		ColorRGB ShadeCookTorrence(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
-			//todo: W3
-			//assert(false && "Not Implemented Yet");
+			const ColorRGB specular{ ShadeSpecular(hitRecord, l, v) };
+			const ColorRGB kd{ m_IsMetal ? ColorRGB{0,0,0} : ColorRGB{1,1,1} - specular };
+			const ColorRGB diffuse{ BRDF::Lambert(kd,m_Color) };
 
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor)
-				+ BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
-		}
-
-	private:
-		ColorRGB m_DiffuseColor{ colors::White };
-		float m_DiffuseReflectance{ 0.5f }; //kd
-		float m_SpecularReflectance{ 0.5f }; //ks
-		float m_PhongExponent{ 1.f }; //Phong Exponent
-	};
-#pragma endregion
-
-#pragma region Material COOK TORRENCE
-	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
-	{
-	public:
-		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness) :
-			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
-		{
+			return { specular + diffuse };
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB ShadeSpecular(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
-			//todo: W3
-			const ColorRGB f0{ (m_Metalness == 1.f) ? m_Albedo : ColorRGB(0.04f,0.04f,0.04f) };
 			const Vector3 h{ Vector3(v + l).Normalized() };
 
-			const ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(h,v,f0) };
-			const float normDistribution{ BRDF::NormalDistribution_GGX(hitRecord.normal,h,m_Roughness)};
-			const float geometry{ BRDF::GeometryFunction_Smith(hitRecord.normal,v,l,m_Roughness) };
+			const ColorRGB fresnel{ BRDF::FresnelFunction_Schlick(h,v,m_F0) };
+			const float normDistribution{ BRDF::NormalDistribution_GGX(hitRecord.normal,h,m_Alpha4) };
+			const float geometry{ BRDF::GeometryFunction_Smith(hitRecord.normal,v,l,m_SchlickK) };
 
 			const float vnDot{ std::min(1.f,std::max(0.f, Vector3::Dot(v,hitRecord.normal))) };
 			const float lnDot{ std::min(1.f,std::max(0.f, Vector3::Dot(l,hitRecord.normal))) };
-			ColorRGB specular{ fresnel * ((normDistribution * geometry) / (4.f * vnDot * lnDot)) };
+			//At grazing angles the geometry term is 0 as well, 0 / 0 would turn the pixel into NaN
+			const float specularDenominator{ 4.f * vnDot * lnDot };
+			ColorRGB specular{ specularDenominator > 0.f ? fresnel * ((normDistribution * geometry) / specularDenominator) : ColorRGB{} };
 			specular.MaxToOne();
-			const ColorRGB kd{ (m_Metalness == 1.f) ? ColorRGB{0,0,0} : ColorRGB{1,1,1} - specular};
-			const ColorRGB diffuse{ BRDF::Lambert(kd,m_Albedo) };
-
-			return { specular+diffuse };
+			return specular;
 		}
-
-	private:
-		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
-		float m_Metalness{ 1.0f };
-		float m_Roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
-#pragma endregion
+	static_assert(sizeof(Material) == 64);
+
+	inline Material Material::CreateSolidColor(const ColorRGB& color)
+	{
+		Material material{};
+		material.m_Type = MaterialType::SolidColor;
+		material.m_Color = color;
+		return material;
+	}
+
+	inline Material Material::CreateLambert(const ColorRGB& diffuseColor, float diffuseReflectance)
+	{
+		Material material{};
+		material.m_Type = MaterialType::Lambert;
+		material.m_Color = diffuseColor;
+		material.m_Diffuse = BRDF::Lambert(diffuseReflectance, diffuseColor);
+		return material;
+	}
+
+	inline Material Material::CreateLambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent)
+	{
+		Material material{ CreateLambert(diffuseColor, kd) };
+		material.m_Type = MaterialType::LambertPhong;
+		material.m_SpecularReflectance = ks;
+		material.m_PhongExponent = phongExponent;
+		return material;
+	}
+
+	inline Material Material::CreateCookTorrence(const ColorRGB& albedo, float metalness, float roughness)
+	{
+		Material material{};
+		material.m_Type = MaterialType::CookTorrence;
+		material.m_Color = albedo;
+		material.m_IsMetal = metalness == 1.f;
+		material.m_F0 = material.m_IsMetal ? albedo : ColorRGB(0.04f, 0.04f, 0.04f);
+		material.m_Alpha4 = BRDF::GetAlpha4(roughness);
+		material.m_SchlickK = BRDF::GetSchlickK(roughness);
+		return material;
+	}
+
+	inline Material Material::CreateDielectric(const ColorRGB& transmittance, float indexOfRefraction)
+	{
+		//Highlights of point lights use a slightly rough surface, a perfectly smooth one would never show them
+		constexpr float highlightRoughness{ 0.1f };
+		const float f0{ Square((indexOfRefraction - 1.f) / (indexOfRefraction + 1.f)) };
+
+		Material material{};
+		material.m_Type = MaterialType::Dielectric;
+		material.m_Color = transmittance;
+		material.m_F0 = ColorRGB{ f0, f0, f0 };
+		material.m_Alpha4 = BRDF::GetAlpha4(highlightRoughness);
+		material.m_SchlickK = BRDF::GetSchlickK(highlightRoughness);
+		material.m_IndexOfRefraction = indexOfRefraction;
+		return material;
+	}
 }
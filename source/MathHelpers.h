@@ -1,5 +1,6 @@
 #pragma once
 #include <cmath>
+#include <cstdint>
 #include <float.h>
 
 namespace dae
@@ -28,4 +29,33 @@ namespace dae
 	{
 		return abs(a - b) < epsilon;
 	}
+
+	//PCG hash, turns correlated seeds (pixel index, frame index) into well distributed ones
+	inline uint32_t HashPCG(uint32_t value)
+	{
+		const uint32_t state{ value * 747796405u + 2891336453u };
+		const uint32_t word{ ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u };
+		return (word >> 22u) ^ word;
+	}
+
+	//Advances state and returns a float in [0, 1)
+	inline float RandomFloat(uint32_t& state)
+	{
+		state = HashPCG(state);
+		return (state >> 8) * (1.f / 16777216.f);
+	}
+
+	//Interleaves the bits of x and y (x in the even bits), sorting by the result walks a Z-order curve
+	inline uint32_t EncodeMorton2D(uint16_t x, uint16_t y)
+	{
+		const auto spreadBits = [](uint32_t value)
+		{
+			value = (value | (value << 8)) & 0x00FF00FFu;
+			value = (value | (value << 4)) & 0x0F0F0F0Fu;
+			value = (value | (value << 2)) & 0x33333333u;
+			value = (value | (value << 1)) & 0x55555555u;
+			return value;
+		};
+		return spreadBits(x) | (spreadBits(y) << 1);
+	}
 }
\ No newline at end of file
@@ -82,6 +82,21 @@ namespace dae {
 		return out;
 	}
 
+	Matrix Matrix::InverseRigid(const Matrix& m)
+	{
+		//The transposed rotation undoes the rotation, the translation is undone in the rotated space
+		const Vector3 xAxis{ m.GetAxisX() };
+		const Vector3 yAxis{ m.GetAxisY() };
+		const Vector3 zAxis{ m.GetAxisZ() };
+		const Vector3 t{ m.GetTranslation() };
+		return Matrix{
+			Vector3{ xAxis.x, yAxis.x, zAxis.x },
+			Vector3{ xAxis.y, yAxis.y, zAxis.y },
+			Vector3{ xAxis.z, yAxis.z, zAxis.z },
+			Vector3{ -Vector3::Dot(t, xAxis), -Vector3::Dot(t, yAxis), -Vector3::Dot(t, zAxis) }
+		};
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -244,5 +259,18 @@ namespace dae {
 
 		return *this;
 	}
+
+	bool Matrix::operator==(const Matrix& m) const
+	{
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				if (data[r][c] != m.data[r][c])
+					return false;
+			}
+		}
+		return true;
+	}
 #pragma endregion
 }
\ No newline at end of file
@@ -41,11 +41,14 @@ namespace dae {
 		static Matrix CreateScale(float sx, float sy, float sz);
 		static Matrix CreateScale(const Vector3& s);
 		static Matrix Transpose(const Matrix& m);
+		//Inverse of a rotation + translation with orthonormal axes, such as a camera or view matrix
+		static Matrix InverseRigid(const Matrix& m);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
 		Matrix operator*(const Matrix& m) const;
 		const Matrix& operator*=(const Matrix& m);
+		bool operator==(const Matrix& m) const;
 
 	private:
 
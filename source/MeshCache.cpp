@@ -0,0 +1,201 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "DataTypes.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint64_t SECTION_ALIGNMENT{ 64 };
+
+		uint64_t AlignOffset(uint64_t offset)
+		{
+			return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+		}
+
+		//FNV-1a
+		uint64_t HashBytes(const char* pData, size_t size)
+		{
+			uint64_t hash{ 14695981039346656037ull };
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= static_cast<unsigned char>(pData[i]);
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		uint64_t HashFile(const std::string& filename)
+		{
+			const MappedFile file{ filename };
+			return HashBytes(file.GetData(), file.GetSize());
+		}
+
+		bool GetSourceInfo(const std::string& sourceFilename, uint64_t& size, int64_t& writeTime)
+		{
+			std::error_code error{};
+			size = std::filesystem::file_size(sourceFilename, error);
+			if (error) return false;
+			writeTime = std::filesystem::last_write_time(sourceFilename, error).time_since_epoch().count();
+			return !error;
+		}
+
+		bool IsSectionValid(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize)
+		{
+			return offset <= fileSize && count <= (fileSize - offset) / elementSize;
+		}
+
+		//Children after their parent and leaves within the triangles keep the hit tests in bounds,
+		//the depth limit keeps their fixed size traversal stacks from overflowing
+		bool IsHierarchyValid(const BVHNode* pNodes, uint64_t nodeCount, uint64_t triangleCount)
+		{
+			std::vector<int> depths(nodeCount, 0);
+			for (uint64_t nodeIndex = 0; nodeIndex < nodeCount; ++nodeIndex)
+			{
+				const BVHNode& node{ pNodes[nodeIndex] };
+				if (node.IsLeaf())
+				{
+					if (uint64_t(node.leftFirst) + node.triangleCount > triangleCount)
+						return false;
+					continue;
+				}
+				if (node.leftFirst <= nodeIndex || uint64_t(node.leftFirst) + 1 >= nodeCount || depths[nodeIndex] + 1 >= BVH::MAX_DEPTH)
+					return false;
+				depths[node.leftFirst] = depths[node.leftFirst + 1] = depths[nodeIndex] + 1;
+			}
+			return true;
+		}
+
+		template<typename T>
+		void WriteSection(std::ofstream& file, uint64_t& writtenBytes, uint64_t offset, const T* pData, uint64_t count)
+		{
+			static constexpr char padding[SECTION_ALIGNMENT]{};
+			file.write(padding, static_cast<std::streamsize>(offset - writtenBytes));
+			file.write(reinterpret_cast<const char*>(pData), static_cast<std::streamsize>(count * sizeof(T)));
+			writtenBytes = offset + count * sizeof(T);
+		}
+	}
+
+	std::string MeshCache::GetCachePath(const std::string& sourceFilename)
+	{
+		return sourceFilename + EXTENSION;
+	}
+
+	bool MeshCache::Load(const std::string& sourceFilename, TriangleMesh& mesh)
+	{
+		const std::string cachePath{ GetCachePath(sourceFilename) };
+		int64_t sourceWriteTime{};
+		bool isWriteTimeStale{};
+		{
+			const MappedFile file{ cachePath };
+			if (!file.IsOpen() || file.GetSize() < sizeof(Header))
+				return false;
+
+			Header header{};
+			memcpy(&header, file.GetData(), sizeof(Header));
+			if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.headerSize != sizeof(Header))
+				return false;
+
+			//A missing source is fine, the cache can be shipped on its own
+			uint64_t sourceSize{};
+			if (GetSourceInfo(sourceFilename, sourceSize, sourceWriteTime))
+			{
+				if (sourceSize != header.sourceSize)
+					return false;
+				if (sourceWriteTime != header.sourceWriteTime && HashFile(sourceFilename) != header.sourceHash)
+					return false;
+				isWriteTimeStale = sourceWriteTime != header.sourceWriteTime;
+			}
+
+			const size_t fileSize{ file.GetSize() };
+			if (!IsSectionValid(header.positionOffset, header.positionCount, sizeof(Vector3), fileSize) ||
+				!IsSectionValid(header.indexOffset, header.indexCount, sizeof(int), fileSize) ||
+				!IsSectionValid(header.nodeOffset, header.nodeCount, sizeof(BVHNode), fileSize) ||
+				header.indexCount % 3 != 0 || header.positionCount > uint64_t(std::numeric_limits<int>::max()))
+				return false;
+
+			const char* const pData{ file.GetData() };
+			const Vector3* pPositions{ reinterpret_cast<const Vector3*>(pData + header.positionOffset) };
+			const int* pIndices{ reinterpret_cast<const int*>(pData + header.indexOffset) };
+			const BVHNode* pNodes{ reinterpret_cast<const BVHNode*>(pData + header.nodeOffset) };
+
+			//Guard against corrupt files before handing the indices to the hit tests
+			const int vertexCount{ static_cast<int>(header.positionCount) };
+			if (!std::all_of(pIndices, pIndices + header.indexCount, [vertexCount](int index) { return index >= 0 && index < vertexCount; }) ||
+				!IsHierarchyValid(pNodes, header.nodeCount, header.indexCount / 3))
+				return false;
+
+			mesh.positions.assign(pPositions, pPositions + header.positionCount);
+			mesh.indices.assign(pIndices, pIndices + header.indexCount);
+			mesh.bvhNodes.assign(pNodes, pNodes + header.nodeCount);
+			mesh.transformedBVHNodes.clear();
+			mesh.minAABB = { header.minAABB[0], header.minAABB[1], header.minAABB[2] };
+			mesh.maxAABB = { header.maxAABB[0], header.maxAABB[1], header.maxAABB[2] };
+		}
+
+		//The source was touched without changing, by a checkout or a copy. Once the cache is unmapped it takes the new
+		//write time, otherwise every later start would hash the whole file again
+		if (isWriteTimeStale)
+		{
+			std::fstream file{ cachePath, std::ios::binary | std::ios::in | std::ios::out };
+			file.seekp(offsetof(Header, sourceWriteTime));
+			file.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+		}
+		return true;
+	}
+
+	bool MeshCache::Write(const std::string& sourceFilename, const TriangleMesh& mesh)
+	{
+		Header header{};
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.headerSize = sizeof(Header);
+
+		if (!GetSourceInfo(sourceFilename, header.sourceSize, header.sourceWriteTime))
+			return false;
+		header.sourceHash = HashFile(sourceFilename);
+
+		header.positionCount = mesh.positions.size();
+		header.indexCount = mesh.indices.size();
+		header.nodeCount = mesh.bvhNodes.size();
+
+		header.positionOffset = AlignOffset(sizeof(Header));
+		header.indexOffset = AlignOffset(header.positionOffset + header.positionCount * sizeof(Vector3));
+		header.nodeOffset = AlignOffset(header.indexOffset + header.indexCount * sizeof(int));
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			header.minAABB[axis] = mesh.minAABB[axis];
+			header.maxAABB[axis] = mesh.maxAABB[axis];
+		}
+
+		//Write to a temporary file first so a reader never maps a half written cache
+		const std::string cachePath{ GetCachePath(sourceFilename) };
+		const std::string tempPath{ cachePath + ".tmp" };
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			if (!file)
+				return false;
+
+			uint64_t writtenBytes{ 0 };
+			WriteSection(file, writtenBytes, 0, &header, 1);
+			WriteSection(file, writtenBytes, header.positionOffset, mesh.positions.data(), header.positionCount);
+			WriteSection(file, writtenBytes, header.indexOffset, mesh.indices.data(), header.indexCount);
+			WriteSection(file, writtenBytes, header.nodeOffset, mesh.bvhNodes.data(), header.nodeCount);
+			if (!file)
+				return false;
+		}
+
+		std::error_code error{};
+		std::filesystem::rename(tempPath, cachePath, error);
+		return !error;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	struct TriangleMesh;
+
+	//Binary snapshot of a parsed mesh (positions, indices, bounds and BVH) stored beside its source file
+	namespace MeshCache
+	{
+		constexpr char MAGIC[8]{ 'R', 'T', 'M', 'E', 'S', 'H', '\0', '\0' };
+		constexpr uint32_t VERSION{ 2 };
+		constexpr const char* EXTENSION{ ".rtmesh" };
+
+		//Little endian, every section starts at a 64 byte aligned offset
+		struct Header
+		{
+			char magic[8]{};
+			uint32_t version{};
+			uint32_t headerSize{};
+
+			//Source validation, the hash is only computed when the size matches but the write time does not
+			uint64_t sourceSize{};
+			int64_t sourceWriteTime{};
+			uint64_t sourceHash{};
+
+			uint64_t positionCount{};
+			uint64_t indexCount{};
+			uint64_t nodeCount{};
+
+			uint64_t positionOffset{};
+			uint64_t indexOffset{};
+			uint64_t nodeOffset{};
+
+			float minAABB[3]{};
+			float maxAABB[3]{};
+		};
+
+		std::string GetCachePath(const std::string& sourceFilename);
+
+		/**
+		 * \brief Fills the mesh geometry, bounds and BVH from the cache of sourceFilename
+		 * \return false if there is no cache or it is outdated/invalid, the mesh is left untouched in that case
+		 */
+		bool Load(const std::string& sourceFilename, TriangleMesh& mesh);
+
+		/**
+		 * \brief Writes the untransformed mesh geometry, bounds and BVH next to sourceFilename
+		 */
+		bool Write(const std::string& sourceFilename, const TriangleMesh& mesh);
+	}
+}
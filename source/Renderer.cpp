@@ -9,14 +9,40 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "FrameArena.h"
+#include "MappedFile.h"
+#include "Checkpoint.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
 #include <execution>
 #include <iostream>
+#include <numeric>
+#include <thread>
 
 //#define PARALEL_EXECUTION
 using namespace dae;
 
 bool Renderer::m_ShadowsEnabled = true;
+bool Renderer::m_ManyLightsEnabled = false;
+bool Renderer::m_LightCullingEnabled = true;
+bool Renderer::m_WavefrontEnabled = false;
+bool Renderer::m_TemporalReuseEnabled = false;
+bool Renderer::m_ChangedTilesEnabled = false;
+bool Renderer::m_DeadlineEnabled = false;
+float Renderer::m_FrameBudget = 0.02f;
+SamplerType Renderer::m_SamplerType = SamplerType::Sobol;
+uint8_t Renderer::m_AreaLightStrata = 4;
+bool Renderer::m_BouncesEnabled = false;
+uint8_t Renderer::m_MaxBounces = 3;
+uint8_t Renderer::m_BounceLimit = 0;
+uint32_t Renderer::m_RayBudget = 0;
+uint8_t Renderer::m_AmbientOcclusionStrata = 4;
+float Renderer::m_AmbientOcclusionRadius = 1.f;
+float Renderer::m_AmbientRadiance = 0.f;
+float Renderer::m_ShadowCutoff = 0.f;
 Renderer::LightingMode Renderer::m_CurrentLightMode = LightingMode::Combined;
 
 Renderer::Renderer(SDL_Window* pWindow) :
@@ -33,22 +59,355 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_PixelIndexes.reserve(m_AmountOfPixels);
 	for (uint32_t index = 0; index < m_AmountOfPixels; ++index) m_PixelIndexes.emplace_back(index);
 #else
-	m_ImageHorizontalIterator.resize(m_Width);
 	m_ImageVerticalIterator.resize(m_Height);
-	for (int index = 0; index < m_Width; ++index)
-		m_ImageHorizontalIterator[index] = index;
 	for (int index = 0; index < m_Height; ++index)
 		m_ImageVerticalIterator[index] = index;
 #endif
+
+	//Sorting by Morton code keeps the curve valid for tile counts that are not a power of two
+	m_TilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY{ (m_Height + TILE_SIZE - 1) / TILE_SIZE };
+	m_TileOrder.resize(size_t(m_TilesX) * tilesY);
+	std::iota(m_TileOrder.begin(), m_TileOrder.end(), 0);
+	std::sort(m_TileOrder.begin(), m_TileOrder.end(), [this](uint32_t a, uint32_t b)
+		{
+			return EncodeMorton2D(uint16_t(a % m_TilesX), uint16_t(a / m_TilesX)) < EncodeMorton2D(uint16_t(b % m_TilesX), uint16_t(b / m_TilesX));
+		});
+	m_IsTileChanged.resize(m_TileOrder.size());
+	m_ChangedTileOrder.reserve(m_TileOrder.size());
+	m_DeadlineTileOrder.reserve(m_TileOrder.size());
+	m_IsTileStale.resize(m_TileOrder.size());
+	m_TileAges.resize(m_TileOrder.size());
+	m_StaleTiles.reserve(m_TileOrder.size());
+	m_DeadlineWorkers.resize(std::max(1u, std::thread::hardware_concurrency()));
+	std::iota(m_DeadlineWorkers.begin(), m_DeadlineWorkers.end(), 0);
+
+	for (int y = 0; y < TILE_SIZE; ++y)
+	{
+		for (int x = 0; x < TILE_SIZE; ++x)
+			m_TilePixelOrder.push_back(static_cast<uint16_t>(x | (y << 8)));
+	}
+	std::sort(m_TilePixelOrder.begin(), m_TilePixelOrder.end(), [](uint16_t a, uint16_t b)
+		{
+			return EncodeMorton2D(a & 0xFF, a >> 8) < EncodeMorton2D(b & 0xFF, b >> 8);
+		});
+}
+
+template<typename TileFunction>
+void Renderer::ForEachTile(const TileFunction& tileFunction) const
+{
+	std::for_each(std::execution::par, m_TileOrder.begin(), m_TileOrder.end(), tileFunction);
+}
+
+template<typename PixelFunction>
+void Renderer::ForEachPixelInTile(uint32_t tileIndex, const PixelFunction& pixelFunction) const
+{
+	const uint32_t firstX{ (tileIndex % m_TilesX) * TILE_SIZE };
+	const uint32_t firstY{ (tileIndex / m_TilesX) * TILE_SIZE };
+	const bool isEdgeTile{ firstX + TILE_SIZE > uint32_t(m_Width) || firstY + TILE_SIZE > uint32_t(m_Height) };
+	for (uint16_t tilePixel : m_TilePixelOrder)
+	{
+		const uint32_t px{ firstX + (tilePixel & 0xFF) };
+		const uint32_t py{ firstY + (tilePixel >> 8) };
+		if (isEdgeTile && (px >= uint32_t(m_Width) || py >= uint32_t(m_Height))) continue;
+		pixelFunction(px + py * m_Width);
+	}
+}
+
+template<typename PixelFunction>
+void Renderer::ForEachPixel(std::span<const uint32_t> tiles, const PixelFunction& pixelFunction) const
+{
+	std::for_each(std::execution::par, tiles.begin(), tiles.end(),
+		[&](uint32_t tileIndex) { ForEachPixelInTile(tileIndex, pixelFunction); });
+}
+
+template<typename TileFunction>
+void Renderer::ForEachTileUntil(std::span<const uint32_t> tiles, std::chrono::steady_clock::time_point deadline, float& tileSeconds,
+	const TileFunction& tileFunction)
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::duration expectedTileTime{ std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(tileSeconds)) };
+
+	//A parallel loop over the tiles would hand each thread a contiguous chunk and lose the order,
+	//instead every thread takes the next tile in line until the time is up
+	std::atomic<size_t> nextTile{};
+	std::atomic<int64_t> renderedTime{};
+	std::atomic<uint32_t> renderedCount{};
+	std::for_each(std::execution::par, m_DeadlineWorkers.begin(), m_DeadlineWorkers.end(), [&](uint32_t)
+		{
+			for (Clock::time_point tileStart{ Clock::now() };; tileStart = Clock::now())
+			{
+				//The first tile always starts, a tile slower than the whole budget would otherwise never be drawn
+				if (tileStart + expectedTileTime >= deadline && nextTile.load() > 0)
+					return;
+				const size_t orderIndex{ nextTile++ };
+				if (orderIndex >= tiles.size())
+					return;
+				tileFunction(tiles[orderIndex]);
+				renderedTime += (Clock::now() - tileStart).count();
+				++renderedCount;
+			}
+		});
+
+	if (renderedCount > 0)
+	{
+		const float averageSeconds{ std::chrono::duration<float>(Clock::duration{ renderedTime / renderedCount }).count() };
+		tileSeconds = tileSeconds > 0.f ? tileSeconds * 0.5f + averageSeconds * 0.5f : averageSeconds;
+	}
+}
+
+template<typename HitFunction, typename PixelFunction>
+void Renderer::FillTileCoarse(uint32_t tileIndex, const HitFunction& hitFunction, const PixelFunction& pixelFunction, const std::vector<Light>& lights)
+{
+	//One pixel per block is traced and copied over the block
+	const int firstX{ int(tileIndex % m_TilesX) * TILE_SIZE };
+	const int firstY{ int(tileIndex / m_TilesX) * TILE_SIZE };
+	const int lastX{ std::min(firstX + TILE_SIZE, m_Width) };
+	const int lastY{ std::min(firstY + TILE_SIZE, m_Height) };
+	const auto forEachBlock{ [&](const auto& blockFunction)
+		{
+			for (int blockY{ firstY }; blockY < lastY; blockY += COARSE_BLOCK_SIZE)
+			{
+				for (int blockX{ firstX }; blockX < lastX; blockX += COARSE_BLOCK_SIZE)
+				{
+					const int blockLastX{ std::min(blockX + COARSE_BLOCK_SIZE, lastX) };
+					const int blockLastY{ std::min(blockY + COARSE_BLOCK_SIZE, lastY) };
+					blockFunction(uint32_t((blockX + blockLastX) / 2 + (blockY + blockLastY) / 2 * m_Width), blockX, blockY, blockLastX, blockLastY);
+				}
+			}
+		} };
+
+	//The tile's clusters only see the traced pixels, hits left over from earlier frames would widen them
+	if (m_UseLightClusters)
+	{
+		ForEachPixelInTile(tileIndex, [&](uint32_t pixelIndex) { m_PrimaryHits[pixelIndex] = {}; });
+		forEachBlock([&](uint32_t samplePixel, int, int, int, int) { hitFunction(samplePixel); });
+		m_LightClusters.BuildTile(tileIndex, lights, m_PrimaryHits, m_Height);
+	}
+	forEachBlock([&](uint32_t samplePixel, int blockX, int blockY, int blockLastX, int blockLastY)
+		{
+			pixelFunction(samplePixel);
+			for (int py{ blockY }; py < blockLastY; ++py)
+				std::fill(m_pBufferPixels + blockX + py * m_Width, m_pBufferPixels + blockLastX + py * m_Width, m_pBufferPixels[samplePixel]);
+		});
+}
+
+void Renderer::SortTilesByPriority(std::span<const uint32_t> tiles)
+{
+	const int centerX{ m_Width / 2 }, centerY{ m_Height / 2 };
+	const auto getCenterDistance{ [&](uint32_t tileIndex)
+		{
+			const int dx{ int(tileIndex % m_TilesX) * TILE_SIZE + TILE_SIZE / 2 - centerX };
+			const int dy{ int(tileIndex / m_TilesX) * TILE_SIZE + TILE_SIZE / 2 - centerY };
+			return dx * dx + dy * dy;
+		} };
+
+	m_DeadlineTileOrder.clear();
+	for (uint32_t tileIndex : tiles)
+	{
+		if (m_IsTileStale[tileIndex])
+			m_DeadlineTileOrder.push_back(tileIndex);
+	}
+	std::sort(m_DeadlineTileOrder.begin(), m_DeadlineTileOrder.end(),
+		[&](uint32_t a, uint32_t b) { return getCenterDistance(a) < getCenterDistance(b); });
+}
+
+void Renderer::Render(Scene* pScene)
+{
+	RenderFrame(pScene, {});
+}
+
+void Renderer::RenderTiles(Scene* pScene, std::span<const uint32_t> tiles, uint32_t sampleIndex)
+{
+	m_RequestSampleIndex = sampleIndex;
+	if (!tiles.empty())
+		RenderFrame(pScene, tiles);
+}
+
+uint32_t Renderer::BeginDistributedFrame(Scene* pScene)
+{
+	//The workers get the depth from the settings. Their rays are not counted here, the coordinator keeps the depth it has
+	UpdateBounceLimit();
+	m_WasShadedFully = false;
+	if (!IsProgressive())
+	{
+		m_AccumulatedFrames = 0;
+		return 0;
+	}
+
+	m_TileSamples.resize(m_AmountOfPixels);
+	Camera& camera{ pScene->GetCamera() };
+	UpdateLights(pScene->GetLights());
+	UpdateAccumulation({ camera.CalculateCameraToWorld(), camera.fovFactor, pScene->GetGeometryVersion(), m_CurrentLightMode, m_ShadowsEnabled,
+		m_SamplerType, m_AreaLightStrata, m_BounceLimit });
+	return m_AccumulatedFrames - 1;
+}
+
+void Renderer::EndDistributedFrame()
+{
+	if (!IsProgressive() || m_AccumulatedFrames == 0)
+		return;
+
+	//The tiles hold this frame's sample of every pixel, display the running average instead like RenderFrame does
+	const float accumulationWeight{ 1.f / m_AccumulatedFrames };
+	for (uint32_t pixelIndex = 0; pixelIndex < uint32_t(m_AmountOfPixels); ++pixelIndex)
+	{
+		m_AccumulationBuffer[pixelIndex] += m_TileSamples[pixelIndex];
+		const ColorRGB& accumulatedColor{ m_AccumulationBuffer[pixelIndex] };
+		WritePixel(pixelIndex, accumulatedColor * accumulationWeight);
+	}
+}
+
+uint32_t Renderer::GetTileCount() const
+{
+	return static_cast<uint32_t>(m_TileOrder.size());
+}
+
+void Renderer::ReadTile(uint32_t tileIndex, std::span<uint32_t> pixels) const
+{
+	const uint32_t wordCount{ GetTileWordCount() };
+	assert(pixels.size() >= wordCount);
+	std::fill_n(pixels.begin(), wordCount, 0u);
+	const bool isProgressive{ IsProgressive() };
+	const int firstX{ int(tileIndex % m_TilesX) * TILE_SIZE };
+	const int firstY{ int(tileIndex / m_TilesX) * TILE_SIZE };
+	for (int y{}; y < TILE_SIZE && firstY + y < m_Height; ++y)
+	{
+		for (int x{}; x < TILE_SIZE && firstX + x < m_Width; ++x)
+		{
+			const uint32_t pixelIndex{ uint32_t(firstX + x + (firstY + y) * m_Width) };
+			const uint32_t tilePixel{ uint32_t(x + y * TILE_SIZE) };
+			if (isProgressive)
+			{
+				const ColorRGB& sample{ m_TileSamples[pixelIndex] };
+				pixels[tilePixel * 3] = std::bit_cast<uint32_t>(sample.r);
+				pixels[tilePixel * 3 + 1] = std::bit_cast<uint32_t>(sample.g);
+				pixels[tilePixel * 3 + 2] = std::bit_cast<uint32_t>(sample.b);
+				continue;
+			}
+			uint8_t r{}, g{}, b{};
+			SDL_GetRGB(m_pBufferPixels[pixelIndex], m_pBuffer->format, &r, &g, &b);
+			pixels[tilePixel] = uint32_t(r) << 16 | uint32_t(g) << 8 | b;
+		}
+	}
 }
 
-void Renderer::Render(Scene* pScene) const
+void Renderer::WriteTile(uint32_t tileIndex, std::span<const uint32_t> pixels)
 {
+	assert(pixels.size() >= GetTileWordCount());
+	const bool isProgressive{ IsProgressive() };
+	const int firstX{ int(tileIndex % m_TilesX) * TILE_SIZE };
+	const int firstY{ int(tileIndex / m_TilesX) * TILE_SIZE };
+	for (int y{}; y < TILE_SIZE && firstY + y < m_Height; ++y)
+	{
+		for (int x{}; x < TILE_SIZE && firstX + x < m_Width; ++x)
+		{
+			const uint32_t pixelIndex{ uint32_t(firstX + x + (firstY + y) * m_Width) };
+			const uint32_t tilePixel{ uint32_t(x + y * TILE_SIZE) };
+			if (isProgressive)
+			{
+				m_TileSamples[pixelIndex] = ColorRGB{ std::bit_cast<float>(pixels[tilePixel * 3]), std::bit_cast<float>(pixels[tilePixel * 3 + 1]),
+					std::bit_cast<float>(pixels[tilePixel * 3 + 2]) };
+				continue;
+			}
+			const uint32_t rgb{ pixels[tilePixel] };
+			m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+				static_cast<uint8_t>(rgb >> 16), static_cast<uint8_t>(rgb >> 8), static_cast<uint8_t>(rgb));
+		}
+	}
+}
+
+void Renderer::PresentFrame()
+{
+	SDL_UpdateWindowSurface(m_pWindow);
+}
+
+void Renderer::RenderFrame(Scene* pScene, std::span<const uint32_t> requestedTiles)
+{
+	const auto frameStart{ std::chrono::steady_clock::now() };
 	Camera& camera = pScene->GetCamera();
-	const auto& materials = pScene->GetMaterials();
 	const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+
+#if defined(TRACK_HEAP_ALLOCATIONS)
+	const size_t heapAllocationsBefore{ GetHeapAllocationCount() };
+#endif
+	FrameArena::BeginFrame();
+
 	const auto& lights = pScene->GetLights();
+	UpdateLights(lights);
+	UpdateRayDirections(cameraToWorld, camera.fovFactor);
+
+	//Tiles of another process' frame follow the depth of the process that requested them
+	const bool isTileRequest{ !requestedTiles.empty() };
+	if (!isTileRequest)
+		UpdateBounceLimit();
+
+	const bool isProgressive{ IsProgressive() };
+	const AccumulationState frameState{ cameraToWorld, camera.fovFactor, pScene->GetGeometryVersion(), m_CurrentLightMode, m_ShadowsEnabled,
+		m_SamplerType, m_AreaLightStrata, m_BounceLimit };
+	//Requested tiles are one sample of the requester's accumulation, which it averages itself
+	const bool isAccumulating{ isProgressive && !isTileRequest };
+	float accumulationWeight{ 1.f };
+	if (isAccumulating)
+	{
+		UpdateAccumulation(frameState);
+		accumulationWeight = 1.f / m_AccumulatedFrames;
+	}
+	else if (!isTileRequest)
+		m_AccumulatedFrames = 0;
+	else if (isProgressive)
+		m_TileSamples.resize(m_AmountOfPixels);
+	//Every accumulated frame is the next sample of each pixel's sequence
+	const uint32_t samplerFrame{ isTileRequest ? m_RequestSampleIndex : isAccumulating ? m_AccumulatedFrames - 1 : 0 };
+	++m_FrameIndex;
+
+	//Shadow rays are queued during the primary pass and traced afterwards as one stream grouped by light
+	//Requested tiles are a piece of another process' frame, they are always rendered from scratch
+	//The accumulation needs a sample of every pixel each frame, it is never cut short
+	const bool useDeadline{ m_DeadlineEnabled && !isProgressive && !isTileRequest };
+	//Area lights trace a varying number of shadow rays per hit, which the queue does not support
+	//Ambient occlusion mode shades no lights, there is nothing to queue or cull
+	const bool isLit{ m_CurrentLightMode != LightingMode::AmbientOcclusion };
+	const bool useWavefront{ m_WavefrontEnabled && m_ShadowsEnabled && !isProgressive && !isTileRequest && !useDeadline &&
+		isLit && m_AreaLightCount == 0 };
+
+	//With a static camera the previous image stays valid outside the tiles that moving meshes touch
+	const RedrawState redrawState{ cameraToWorld, camera.fovFactor, m_CurrentLightMode, m_ShadowsEnabled, m_LightCullingEnabled, m_ShadowCutoff,
+		m_BounceLimit, isProgressive };
+	const bool isSameMeshSet{ UpdateMeshBounds(pScene) };
+	//A moving mesh shows up in reflections anywhere on screen, the changed tiles no longer bound what changed
+	const bool isPartialRedraw{ m_ChangedTilesEnabled && isSameMeshSet && m_HasRedrawHistory && !isProgressive &&
+		!useWavefront && !isTileRequest && m_BounceLimit == 0 && redrawState == m_RedrawState };
+	std::span<const uint32_t> renderTiles{ isTileRequest ? requestedTiles : std::span<const uint32_t>{ m_TileOrder } };
+	if (isPartialRedraw)
+	{
+		FindChangedTiles(pScene, cameraToWorld, camera.fovFactor);
+		renderTiles = m_ChangedTileOrder;
+	}
+	m_PrimaryHits.resize(m_AmountOfPixels);
+	//Pixels of the tiles that miss the deadline are still right when nothing changed since they were drawn
+	const bool isSameView{ redrawState == m_RedrawState && isSameMeshSet && m_ChangedBounds.empty() };
+
+	//Culling needs every primary hit before shading, trace them in a separate pass and build the clusters from them
+	m_UseLightClusters = m_LightCullingEnabled && !isProgressive && isLit && m_BoundedLightCount > 0;
+	const auto tracePrimaryHit{ [&](uint32_t pixelIndex)
+		{
+			HitRecord closestHit{};
+			pScene->GetClosestHit(Ray{ camera.origin, GetRayDirection(pixelIndex) }, closestHit);
+			m_PrimaryHits[pixelIndex] = closestHit;
+		} };
+	//A pass over the whole image would use up the budget before the first tile, in deadline mode every tile builds its own clusters
+	if (m_UseLightClusters && useDeadline)
+		m_LightClusters.Prepare(lights, m_Width, m_Height);
+	else if (m_UseLightClusters)
+	{
+		ForEachPixel(renderTiles, tracePrimaryHit);
+		m_LightClusters.Build(lights, m_PrimaryHits, m_Width, m_Height);
+	}
 
+	//Complete frames show every pixel traced for the current view, a full trace also retraced all of them this frame
+	bool isFrameComplete{ true };
+	bool isFullTrace{ true };
 #if defined(PARALEL_EXECUTION)
 
 	std::for_each(std::execution::par, m_PixelIndexes.begin(), m_PixelIndexes.end(), [&](int i)
@@ -57,72 +416,131 @@ void Renderer::Render(Scene* pScene) const
 			RenderPixel(pScene, i, camera.fovFactor, cameraToWorld, camera.origin);
 		});
 #else
-	std::for_each(std::execution::par, m_ImageVerticalIterator.begin(), m_ImageVerticalIterator.end(), [&](uint32_t py)
+	//Surfaces that were already visible last frame keep their shading, only the primary ray is traced for them
+	const bool useTemporalReuse{ m_TemporalReuseEnabled && !isProgressive && !useWavefront && !isPartialRedraw && !isTileRequest };
+	const TemporalState temporalState{ frameState.geometryVersion, m_CurrentLightMode, m_ShadowsEnabled, m_UseLightClusters, m_BounceLimit };
+	const bool hasHistory{ useTemporalReuse && m_HasTemporalHistory && temporalState == m_TemporalState };
+	if (useTemporalReuse)
+	{
+		m_TemporalSamples.resize(m_AmountOfPixels);
+		m_PreviousTemporalSamples.resize(m_AmountOfPixels);
+	}
+
+	const auto renderPixel{ [&](uint32_t pixelIndex)
 		{
-			float cy = (1 - 2 * (py + 0.5f) / m_Height) * camera.fovFactor;
-		
-			std::for_each(std::execution::par, m_ImageHorizontalIterator.begin(), m_ImageHorizontalIterator.end(), [&](uint32_t px)
-				{
-					Vector3 rayDirection{};
-					float cx = (2.f * (px + 0.5f) / m_Width - 1.f) * m_AspectRatio * camera.fovFactor;
+			const Sampler sampler{ m_SamplerType, pixelIndex % m_Width, pixelIndex / m_Width, samplerFrame };
+			//The accumulation averages rays spread over the pixel, which antialiases the edges
+			const Vector3 rayDirection{ isProgressive ?
+				GetRayDirection(pixelIndex, sampler.Get(SampleDimension::PixelX), sampler.Get(SampleDimension::PixelY), cameraToWorld, camera.fovFactor) :
+				GetRayDirection(pixelIndex) };
+			HitRecord closestHit{};
+			ColorRGB finalColor{};
 
-					rayDirection = Vector3{ cx, cy ,1 };
-					rayDirection = cameraToWorld.TransformVector(rayDirection);
-					rayDirection.Normalize();
+			if (m_UseLightClusters)
+				closestHit = m_PrimaryHits[pixelIndex];
+			else
+			{
+				pScene->GetClosestHit(Ray{ camera.origin, rayDirection }, closestHit);
+				m_PrimaryHits[pixelIndex] = closestHit;
+			}
 
-					Ray hitRay{ camera.origin, rayDirection };
-					ColorRGB finalColor{};
-					HitRecord closestHit{};
+			if (closestHit.didHit && !(hasHistory && TryReuseShading(closestHit, pixelIndex, finalColor)))
+				finalColor = ShadeHit(pScene, closestHit, rayDirection, pixelIndex, sampler);
 
-					pScene->GetClosestHit(hitRay, closestHit);
-					if (closestHit.didHit)
-					{
-						for (const Light& light : lights)
-						{
-							const Vector3 lightRayIntersectPoint{ closestHit.origin + 0.00001f * closestHit.normal };
-							Vector3 lightRayDir{ LightUtils::GetDirectionToLight(light,lightRayIntersectPoint) };
-							const float lightRayDist{ lightRayDir.Normalize() };
-
-							const Ray lightRay{ lightRayIntersectPoint, lightRayDir, 0.001f, lightRayDist };
-
-							const float lightDirCos{ Vector3::Dot(closestHit.normal,lightRayDir) };
-
-							if (!pScene->DoesHit(lightRay) || !m_ShadowsEnabled)
-							{
-								switch (m_CurrentLightMode)
-								{
-								case LightingMode::Combined:
-									if (lightDirCos >= 0)
-										finalColor += LightUtils::GetRadiance(light, lightRayIntersectPoint) * lightDirCos
-										* materials[closestHit.materialIndex]->Shade(closestHit, lightRayDir, -rayDirection);
-									break;
-								case LightingMode::ObservedArea:
-									if (lightDirCos >= 0)
-										finalColor += lightDirCos * ColorRGB{1, 1, 1};
-									break;
-								case LightingMode::Radiance:
-									finalColor += LightUtils::GetRadiance(light, lightRayIntersectPoint);
-									break;
-								case LightingMode::BRDF:
-									if (lightDirCos >= 0)
-										finalColor += materials[closestHit.materialIndex]->Shade(closestHit, lightRayDir, -rayDirection);
-									break;
-								}
-							}
+			if (useTemporalReuse)
+				m_TemporalSamples[pixelIndex] = { closestHit.origin, closestHit.normal, finalColor, closestHit.materialIndex, closestHit.didHit };
 
-						}
-						//Update Color in Buffer
-						finalColor.MaxToOne();
-					}
-					m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
+			if (isAccumulating)
+			{
+				//Display the running average of all frames since the last change
+				m_AccumulationBuffer[pixelIndex] += finalColor;
+				const ColorRGB& accumulatedColor{ m_AccumulationBuffer[pixelIndex] };
+				finalColor = accumulatedColor * accumulationWeight;
+			}
+
+			else if (isProgressive)
+				m_TileSamples[pixelIndex] = finalColor;
+
+			WritePixel(pixelIndex, finalColor);
+		} };
+
+	if (useWavefront)
+		RenderWavefront(pScene, camera.origin);
+	else if (useDeadline)
+	{
+		//With the same view only the tiles that missed earlier deadlines are traced again
+		if (!isSameView)
+		{
+			for (uint32_t tileIndex : renderTiles)
+				m_IsTileStale[tileIndex] = 1;
+		}
+		SortTilesByPriority(renderTiles);
+		const auto budget{ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(m_FrameBudget)) };
+		ForEachTileUntil(m_DeadlineTileOrder, frameStart + budget, m_TileSeconds, [&](uint32_t tileIndex)
+			{
+				if (m_UseLightClusters)
+				{
+					ForEachPixelInTile(tileIndex, tracePrimaryHit);
+					m_LightClusters.BuildTile(tileIndex, lights, m_PrimaryHits, m_Height);
+				}
+				ForEachPixelInTile(tileIndex, renderPixel);
+				m_IsTileStale[tileIndex] = 0;
+				m_TileAges[tileIndex] = 0;
+			});
+
+		m_StaleTiles.clear();
+		for (uint32_t tileIndex : m_DeadlineTileOrder)
+		{
+			if (m_IsTileStale[tileIndex])
+				m_StaleTiles.push_back(tileIndex);
+		}
+		isFrameComplete = m_StaleTiles.empty();
+		isFullTrace = isFrameComplete && m_DeadlineTileOrder.size() == renderTiles.size();
+
+		//After a view change the stale pixels are wrong, whatever the coarse fill reaches is traced at a lower resolution instead.
+		//Either way the stale tiles go first next frame
+		if (!isSameView)
+		{
+			//Oldest first, when the view keeps changing the coarse fill still reaches every tile in turn
+			for (uint32_t tileIndex : m_StaleTiles)
+				++m_TileAges[tileIndex];
+			std::stable_sort(m_StaleTiles.begin(), m_StaleTiles.end(), [&](uint32_t a, uint32_t b) { return m_TileAges[a] > m_TileAges[b]; });
+			const auto coarseDeadline{ frameStart + budget + std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget * COARSE_BUDGET_FRACTION) };
+			ForEachTileUntil(m_StaleTiles, coarseDeadline, m_CoarseTileSeconds, [&](uint32_t tileIndex)
+				{
+					FillTileCoarse(tileIndex, tracePrimaryHit, renderPixel, lights);
+					m_TileAges[tileIndex] = 0;
 				});
-			
-		});
+		}
+	}
+	else
+	{
+		ForEachPixel(renderTiles, renderPixel);
+		if (!isTileRequest)
+			std::fill(m_IsTileStale.begin(), m_IsTileStale.end(), uint8_t{ 0 });
+	}
+#endif
+	if (!isTileRequest)
+		SDL_UpdateWindowSurface(m_pWindow);
+
+	//This frame becomes the history of the next one. Reused shading is not exact and the wavefront
+	//pass keeps no primary hits, neither can be the base of a partial redraw
+	m_HasRedrawHistory = !isProgressive && !useWavefront && !hasHistory && !isTileRequest && isFrameComplete;
+	m_RedrawState = redrawState;
+	m_HasTemporalHistory = useTemporalReuse && isFullTrace;
+	if (!isTileRequest)
+		m_WasShadedFully = isFullTrace && !isPartialRedraw && !hasHistory;
+	if (useTemporalReuse)
+	{
+		std::swap(m_TemporalSamples, m_PreviousTemporalSamples);
+		m_PreviousWorldToCamera = Matrix::InverseRigid(cameraToWorld);
+		m_PreviousFovFactor = camera.fovFactor;
+		m_TemporalState = temporalState;
+	}
+
+#if defined(TRACK_HEAP_ALLOCATIONS)
+	CheckHeapAllocations(frameState, GetHeapAllocationCount() - heapAllocationsBefore);
 #endif
-	SDL_UpdateWindowSurface(m_pWindow);
 
 #pragma region oldFor
 	//float cx, cy;
@@ -200,6 +618,219 @@ bool Renderer::SaveBufferToImage() const
 	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
 }
 
+bool Renderer::RenderStill(Scene* pScene, int width, int height, const std::string& filename, uint32_t sampleCount)
+{
+	const std::string header{ "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n" };
+	const size_t rowSize{ size_t(width) * 3 };
+	MappedFile file{};
+	if (width <= 0 || height <= 0 || !file.Create(filename, header.size() + rowSize * height))
+		return false;
+	std::copy(header.begin(), header.end(), file.GetWritableData());
+	uint8_t* const pImage{ reinterpret_cast<uint8_t*>(file.GetWritableData() + header.size()) };
+
+	Camera& camera{ pScene->GetCamera() };
+	const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+	const Vector3 right{ cameraToWorld.GetAxisX() };
+	const Vector3 up{ cameraToWorld.GetAxisY() };
+	const Vector3 forward{ cameraToWorld.GetAxisZ() };
+	const float fovFactor{ camera.fovFactor };
+	const float aspectRatio{ float(width) / height };
+
+	FrameArena::BeginFrame();
+	UpdateLights(pScene->GetLights());
+	++m_FrameIndex;
+	//A still has no frames to adapt the depth over, it goes as deep as allowed
+	m_BounceLimit = m_BouncesEnabled ? m_MaxBounces : 0;
+	m_SecondaryRayCount = 0;
+	//The window's cluster grid covers the window, culling builds a grid per tile instead
+	m_UseLightClusters = false;
+	const bool isProgressive{ IsProgressive() };
+	const bool useLightClusters{ m_LightCullingEnabled && !isProgressive && m_CurrentLightMode != LightingMode::AmbientOcclusion &&
+		m_BoundedLightCount > 0 };
+	sampleCount = isProgressive ? std::max(sampleCount, 1u) : 1;
+
+	const int tilesX{ (width + TILE_SIZE - 1) / TILE_SIZE };
+	const int tilesY{ (height + TILE_SIZE - 1) / TILE_SIZE };
+	std::vector<uint32_t> rowTiles(tilesX);
+	std::iota(rowTiles.begin(), rowTiles.end(), 0);
+	int printedPercentage{};
+	for (int tileY{}; tileY < tilesY; ++tileY)
+	{
+		const int firstY{ tileY * TILE_SIZE };
+		const int lastY{ std::min(firstY + TILE_SIZE, height) };
+		std::for_each(std::execution::par, rowTiles.begin(), rowTiles.end(), [&](uint32_t tileX)
+			{
+				//Scratch of one tile per thread, reused for every tile the thread renders
+				static thread_local std::vector<HitRecord> tileHits{};
+				static thread_local LightClusterGrid tileClusters{};
+				const int firstX{ int(tileX) * TILE_SIZE };
+				const int tileWidth{ std::min(TILE_SIZE, width - firstX) };
+				const int tileHeight{ lastY - firstY };
+				tileHits.resize(size_t(tileWidth) * tileHeight);
+
+				//Same math as UpdateRayDirections, a still at the window resolution matches the window
+				const auto getRayDirection{ [&](int px, int py, float offsetX = 0.5f, float offsetY = 0.5f)
+					{
+						const float cy = (1 - 2 * (py + offsetY) / height) * fovFactor;
+						const float cx = (2.f * (px + offsetX) / width - 1.f) * aspectRatio * fovFactor;
+						const float x{ right.x * cx + up.x * cy + forward.x };
+						const float y{ right.y * cx + up.y * cy + forward.y };
+						const float z{ right.z * cx + up.z * cy + forward.z };
+						const float length{ sqrtf(x * x + y * y + z * z) };
+						return Vector3{ x / length, y / length, z / length };
+					} };
+
+				//Progressive modes trace their own primary ray per sample
+				for (uint16_t tilePixel : m_TilePixelOrder)
+				{
+					const int x{ tilePixel & 0xFF }, y{ tilePixel >> 8 };
+					if (isProgressive || x >= tileWidth || y >= tileHeight) continue;
+					HitRecord& hit{ tileHits[x + y * tileWidth] };
+					hit = {};
+					pScene->GetClosestHit(Ray{ camera.origin, getRayDirection(firstX + x, firstY + y) }, hit);
+				}
+				if (useLightClusters)
+					tileClusters.Build(pScene->GetLights(), tileHits, tileWidth, tileHeight);
+
+				for (uint16_t tilePixel : m_TilePixelOrder)
+				{
+					const int x{ tilePixel & 0xFF }, y{ tilePixel >> 8 };
+					if (x >= tileWidth || y >= tileHeight) continue;
+					const int px{ firstX + x }, py{ firstY + y };
+					const uint32_t tilePixelIndex{ uint32_t(x + y * tileWidth) };
+					const HitRecord& hit{ tileHits[tilePixelIndex] };
+					ColorRGB finalColor{};
+					if (isProgressive)
+					{
+						//The sequence the window accumulates, the still reaches the same image in one go
+						for (uint32_t sample{}; sample < sampleCount; ++sample)
+						{
+							const Sampler sampler{ m_SamplerType, uint32_t(px), uint32_t(py), sample };
+							const Vector3 rayDirection{ getRayDirection(px, py, sampler.Get(SampleDimension::PixelX), sampler.Get(SampleDimension::PixelY)) };
+							HitRecord sampleHit{};
+							pScene->GetClosestHit(Ray{ camera.origin, rayDirection }, sampleHit);
+							if (sampleHit.didHit)
+								finalColor += ShadeHit(pScene, sampleHit, rayDirection, uint32_t(px + size_t(py) * width), sampler);
+						}
+						finalColor *= 1.f / sampleCount;
+					}
+					else if (hit.didHit)
+					{
+						const Vector3 rayDirection{ getRayDirection(px, py) };
+						const Sampler sampler{ m_SamplerType, uint32_t(px), uint32_t(py), 0 };
+						if (useLightClusters)
+						{
+							finalColor += ShadeLights(pScene, hit, rayDirection, tileClusters.GetGlobalLights(), sampler);
+							finalColor += ShadeLights(pScene, hit, rayDirection, tileClusters.GetLights(tilePixelIndex), sampler);
+							finalColor += ShadeIndirect(pScene, hit, rayDirection, sampler);
+						}
+						else finalColor = ShadeHit(pScene, hit, rayDirection, uint32_t(px + size_t(py) * width), sampler);
+					}
+
+					finalColor.MaxToOne();
+					uint8_t* const pPixel{ pImage + size_t(py) * rowSize + size_t(px) * 3 };
+					pPixel[0] = static_cast<uint8_t>(finalColor.r * 255);
+					pPixel[1] = static_cast<uint8_t>(finalColor.g * 255);
+					pPixel[2] = static_cast<uint8_t>(finalColor.b * 255);
+				}
+			});
+
+		//The finished rows go to disk, only the row of tiles in progress stays in memory
+		const size_t rowsStart{ header.size() + size_t(firstY) * rowSize };
+		file.Release(rowsStart, size_t(lastY - firstY) * rowSize);
+
+		const int percentage{ (tileY + 1) * 100 / tilesY };
+		if (percentage / 10 > printedPercentage / 10)
+		{
+			std::cout << "Still " << percentage << "%\n";
+			printedPercentage = percentage;
+		}
+	}
+	m_LastSecondaryRayCount = m_SecondaryRayCount.exchange(0);
+	m_WasShadedFully = false;
+	return true;
+}
+
+bool Renderer::CaptureCheckpoint(Scene* pScene, RenderCheckpoint& checkpoint) const
+{
+	if (!IsProgressive() || m_AccumulatedFrames == 0)
+		return false;
+
+	const Camera& camera{ pScene->GetCamera() };
+	checkpoint.width = m_Width;
+	checkpoint.height = m_Height;
+	checkpoint.lightCount = static_cast<uint32_t>(m_LightSourceCount);
+	checkpoint.cameraOrigin = camera.origin;
+	checkpoint.cameraPitch = camera.totalPitch;
+	checkpoint.cameraYaw = camera.totalYaw;
+	checkpoint.cameraFovAngle = camera.fovAngle;
+	checkpoint.settings = GetSettings();
+	checkpoint.cameraToWorld = m_AccumulationState.cameraToWorld;
+	checkpoint.fovFactor = m_AccumulationState.fovFactor;
+	checkpoint.geometryVersion = m_AccumulationState.geometryVersion;
+	checkpoint.frameIndex = m_FrameIndex;
+	checkpoint.accumulatedFrames = m_AccumulatedFrames;
+	checkpoint.accumulation.assign(m_AccumulationBuffer.begin(), m_AccumulationBuffer.end());
+	return true;
+}
+
+bool Renderer::ResumeCheckpoint(Scene* pScene, const RenderCheckpoint& checkpoint)
+{
+	const auto& lights{ pScene->GetLights() };
+	if (checkpoint.width != m_Width || checkpoint.height != m_Height || checkpoint.lightCount != lights.size() ||
+		checkpoint.accumulation.size() != size_t(m_AmountOfPixels))
+		return false;
+
+	//The camera's orientation is rebuilt from pitch and yaw by the next scene update
+	Camera& camera{ pScene->GetCamera() };
+	camera.origin = checkpoint.cameraOrigin;
+	camera.totalPitch = checkpoint.cameraPitch;
+	camera.totalYaw = checkpoint.cameraYaw;
+	camera.UpdateFOV(checkpoint.cameraFovAngle);
+	ApplySettings(checkpoint.settings);
+
+	//Lights first, a new light set clears the accumulation
+	UpdateLights(lights);
+	m_AccumulationBuffer = checkpoint.accumulation;
+	m_AccumulationState = { checkpoint.cameraToWorld, checkpoint.fovFactor, checkpoint.geometryVersion,
+		m_CurrentLightMode, m_ShadowsEnabled, m_SamplerType, m_AreaLightStrata, m_BounceLimit };
+	m_AccumulatedFrames = checkpoint.accumulatedFrames;
+	m_FrameIndex = checkpoint.frameIndex;
+	return true;
+}
+
+Renderer::Settings Renderer::GetSettings()
+{
+	return { static_cast<uint8_t>(m_CurrentLightMode), m_ShadowsEnabled, m_ManyLightsEnabled, m_LightCullingEnabled, m_SamplerType,
+		m_AreaLightStrata, m_BounceLimit, m_AmbientOcclusionStrata, m_ShadowCutoff, m_AmbientOcclusionRadius, m_AmbientRadiance };
+}
+
+bool Renderer::AreSettingsValid(const Settings& settings)
+{
+	return settings.lightMode < uint8_t(LightingMode::Count) && settings.samplerType < SamplerType::Count &&
+		settings.areaLightStrata >= 1 && settings.areaLightStrata <= MAX_AREA_LIGHT_STRATA && settings.maxBounces <= MAX_BOUNCES &&
+		settings.ambientOcclusionStrata >= 1 && settings.ambientOcclusionStrata <= MAX_AMBIENT_OCCLUSION_STRATA;
+}
+
+void Renderer::ApplySettings(const Settings& settings)
+{
+	m_CurrentLightMode = LightingMode(settings.lightMode % uint8_t(LightingMode::Count));
+	m_ShadowsEnabled = settings.shadowsEnabled;
+	m_ManyLightsEnabled = settings.manyLightsEnabled;
+	m_LightCullingEnabled = settings.lightCullingEnabled;
+	m_SamplerType = SamplerType(uint8_t(settings.samplerType) % uint8_t(SamplerType::Count));
+	SetAreaLightSamples(settings.areaLightStrata * settings.areaLightStrata);
+	//The depth the accumulation was rendered at, a ray budget would otherwise change it mid accumulation
+	m_BouncesEnabled = settings.maxBounces > 0;
+	if (m_BouncesEnabled)
+		m_MaxBounces = uint8_t(std::min(int(settings.maxBounces), MAX_BOUNCES));
+	m_BounceLimit = m_BouncesEnabled ? m_MaxBounces : 0;
+	m_ShadowCutoff = settings.shadowCutoff;
+	SetAmbientOcclusionSamples(settings.ambientOcclusionStrata * settings.ambientOcclusionStrata);
+	m_AmbientOcclusionRadius = settings.ambientOcclusionRadius;
+	m_AmbientRadiance = settings.ambientRadiance;
+}
+
 void Renderer::ToggleShadow()
 {
 	m_ShadowsEnabled = !m_ShadowsEnabled;
@@ -207,65 +838,952 @@ void Renderer::ToggleShadow()
 
 void Renderer::ToggleLightMode()
 {
-	m_CurrentLightMode = LightingMode((int(m_CurrentLightMode) + 1) % 4);
+	m_CurrentLightMode = LightingMode((int(m_CurrentLightMode) + 1) % int(LightingMode::Count));
 }
 
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, const Matrix cameraToWorld, const Vector3 cameraOrigin) const
+void Renderer::SetLightMode(LightingMode mode)
 {
-	auto& lights = pScene->GetLights();
-	auto materials{ pScene->GetMaterials() };
+	m_CurrentLightMode = mode;
+}
 
-	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+void Renderer::ToggleManyLights()
+{
+	m_ManyLightsEnabled = !m_ManyLightsEnabled;
+}
 
-	float rx{ px + 0.5f }, ry{ py + 0.5f };
-	float cx{ 2.f * (rx / float(m_Width) - 1.f)* m_AspectRatio * fov };
-	float cy{ 1 - (2 * (ry / float(m_Height))) * fov };
+void Renderer::ToggleLightCulling()
+{
+	m_LightCullingEnabled = !m_LightCullingEnabled;
+}
 
-	Vector3 rayDirection{};
-	rayDirection = Vector3{ cx, cy ,1 };
-	rayDirection = cameraToWorld.TransformVector(rayDirection);
-	rayDirection.Normalize();
-	Ray hitRay{ cameraOrigin, rayDirection };
-	ColorRGB finalColor{};
-	HitRecord closestHit{};
-	pScene->GetClosestHit(hitRay, closestHit);
-	if (closestHit.didHit)
-	{
+void Renderer::ToggleWavefront()
+{
+	m_WavefrontEnabled = !m_WavefrontEnabled;
+}
 
-		for (const Light& light : lights)
-		{
-			const Vector3 lightRayIntersectPoint{ closestHit.origin + 0.00001f * closestHit.normal };
-			Vector3 lightRayDir{ LightUtils::GetDirectionToLight(light,lightRayIntersectPoint) };
-			const float lightRayDist{ lightRayDir.Normalize() };
+void Renderer::ToggleTemporalReuse()
+{
+	m_TemporalReuseEnabled = !m_TemporalReuseEnabled;
+}
 
-			const Ray lightRay{ lightRayIntersectPoint, lightRayDir, 0.001f, lightRayDist };
+void Renderer::ToggleChangedTiles()
+{
+	m_ChangedTilesEnabled = !m_ChangedTilesEnabled;
+}
 
-			const float lightDirCos{ Vector3::Dot(closestHit.normal,lightRayDir) };
+void Renderer::ToggleDeadline()
+{
+	m_DeadlineEnabled = !m_DeadlineEnabled;
+}
 
-			if (!pScene->DoesHit(lightRay) || !m_ShadowsEnabled)
-			{
-				switch (m_CurrentLightMode)
-				{
-				case LightingMode::Combined:
-					if (lightDirCos >= 0)
-						finalColor += LightUtils::GetRadiance(light, lightRayIntersectPoint) * lightDirCos
-						* materials[closestHit.materialIndex]->Shade(closestHit, lightRayDir, -rayDirection);
-					break;
-				case LightingMode::ObservedArea:
-					if (lightDirCos >= 0)
-						finalColor += lightDirCos * ColorRGB{ 1, 1, 1 };
-					break;
-				case LightingMode::Radiance:
-					finalColor += LightUtils::GetRadiance(light, lightRayIntersectPoint);
-					break;
-				case LightingMode::BRDF:
-					if (lightDirCos >= 0)
-						finalColor += materials[closestHit.materialIndex]->Shade(closestHit, lightRayDir, -rayDirection);
-					break;
-				}
-			}
+void Renderer::SetFrameBudget(float milliseconds)
+{
+	m_FrameBudget = milliseconds / 1000.f;
+}
 
-		}
+void Renderer::ToggleSampler()
+{
+	SetSamplerType(SamplerType((uint8_t(m_SamplerType) + 1) % uint8_t(SamplerType::Count)));
+}
+
+void Renderer::SetSamplerType(SamplerType type)
+{
+	m_SamplerType = type;
+}
+
+void Renderer::SetAreaLightSamples(int samples)
+{
+	//Even so the strata split into four quadrants for the penumbra test
+	const int strata{ 2 * int(std::lround(sqrtf(float(std::max(samples, 1))) * 0.5f)) };
+	m_AreaLightStrata = uint8_t(std::clamp(strata, 2, MAX_AREA_LIGHT_STRATA));
+}
+
+void Renderer::SetMaxBounces(int bounces)
+{
+	m_BouncesEnabled = bounces > 0;
+	if (m_BouncesEnabled)
+		m_MaxBounces = uint8_t(std::min(bounces, MAX_BOUNCES));
+}
+
+void Renderer::ToggleBounces()
+{
+	m_BouncesEnabled = !m_BouncesEnabled;
+}
+
+void Renderer::SetRayBudget(uint32_t rays)
+{
+	m_RayBudget = rays;
+}
+
+void Renderer::UpdateBounceLimit()
+{
+	m_LastSecondaryRayCount = m_SecondaryRayCount.exchange(0, std::memory_order_relaxed);
+	if (!m_BouncesEnabled)
+	{
+		m_BounceLimit = 0;
+		return;
+	}
+	//The accumulation needs every frame at the same depth
+	if (m_RayBudget == 0 || IsProgressive() || m_BounceLimit == 0)
+	{
+		m_BounceLimit = m_MaxBounces;
+		return;
+	}
+
+	//Partial redraws, deadline frames and reused shading trace fewer rays than the depth costs, they would make it oscillate
+	if (!m_WasShadedFully)
+		return;
+
+	//One level at a time so the image does not flicker between depths. A level adds at most as many rays as
+	//the one above it traced, only go deeper when that still fits with room to spare
+	if (m_LastSecondaryRayCount > m_RayBudget && m_BounceLimit > 1)
+		--m_BounceLimit;
+	else if (m_BounceLimit < m_MaxBounces && m_LastSecondaryRayCount * 3 <= m_RayBudget)
+		++m_BounceLimit;
+	m_BounceLimit = std::min(m_BounceLimit, m_MaxBounces);
+}
+
+void Renderer::SetAmbientOcclusionSamples(int samples)
+{
+	const int strata{ int(std::lround(sqrtf(float(std::max(samples, 1))))) };
+	m_AmbientOcclusionStrata = uint8_t(std::clamp(strata, 1, MAX_AMBIENT_OCCLUSION_STRATA));
+}
+
+void Renderer::SetAmbientOcclusionRadius(float distance)
+{
+	m_AmbientOcclusionRadius = distance;
+}
+
+void Renderer::SetAmbientRadiance(float radiance)
+{
+	m_AmbientRadiance = radiance;
+}
+
+void Renderer::SetShadowCutoff(float cutoff)
+{
+	m_ShadowCutoff = cutoff;
+}
+
+void Renderer::UpdateLights(const std::vector<Light>& lights)
+{
+	//Lights are only added while a scene initializes, rebuild when a different set shows up
+	if (lights.data() == m_pLightSource && lights.size() == m_LightSourceCount)
+		return;
+
+	m_LightTree.Build(lights);
+	m_BoundedLightCount = std::count_if(lights.begin(), lights.end(),
+		[](const Light& light) { return light.type == LightType::Point && light.influenceRadius > 0.f; });
+	m_AreaLightCount = std::count_if(lights.begin(), lights.end(), LightUtils::IsAreaLight);
+	m_AllLightIndices.resize(lights.size());
+	std::iota(m_AllLightIndices.begin(), m_AllLightIndices.end(), 0);
+	m_pLightSource = lights.data();
+	m_LightSourceCount = lights.size();
+	m_AccumulatedFrames = 0;
+	m_HasTemporalHistory = false;
+	m_HasRedrawHistory = false;
+	std::fill(m_IsTileStale.begin(), m_IsTileStale.end(), uint8_t{ 1 });
+}
+
+void Renderer::UpdateAccumulation(const AccumulationState& state)
+{
+	if (m_AccumulatedFrames == 0 || !(state == m_AccumulationState))
+	{
+		m_AccumulationBuffer.assign(m_AmountOfPixels, ColorRGB{});
+		m_AccumulationState = state;
+		m_AccumulatedFrames = 0;
+	}
+	++m_AccumulatedFrames;
+}
+
+#if defined(TRACK_HEAP_ALLOCATIONS)
+void Renderer::CheckHeapAllocations(const AccumulationState& state, size_t allocationCount)
+{
+	//Buffers, arenas and per thread caches may grow in the frames after a change, once they settled the same frame must reuse them
+	const bool isSameFrame{ state == m_AllocationCheckState && m_ManyLightsEnabled == m_AllocationCheckManyLights &&
+		m_LightCullingEnabled == m_AllocationCheckLightCulling };
+	m_UnchangedFrames = isSameFrame ? m_UnchangedFrames + 1 : 0;
+	m_AllocationCheckState = state;
+	m_AllocationCheckManyLights = m_ManyLightsEnabled;
+	m_AllocationCheckLightCulling = m_LightCullingEnabled;
+
+	if (m_UnchangedFrames >= ALLOCATION_WARMUP_FRAMES && allocationCount > 0)
+	{
+		std::cerr << "Render made " << allocationCount << " heap allocations in a steady state frame\n";
+		assert(false && "Steady state frames must not allocate");
+	}
+}
+#endif
+
+void Renderer::UpdateRayDirections(const Matrix& cameraToWorld, float fovFactor)
+{
+	//Directions only depend on the orientation and fov, a camera that just moves keeps them
+	const Vector3 right{ cameraToWorld.GetAxisX() };
+	const Vector3 up{ cameraToWorld.GetAxisY() };
+	const Vector3 forward{ cameraToWorld.GetAxisZ() };
+	if (m_RayDirectionsValid && fovFactor == m_RayDirectionsFov && forward.x == m_RayDirectionsForward.x &&
+		forward.y == m_RayDirectionsForward.y && forward.z == m_RayDirectionsForward.z)
+		return;
+
+	m_RayDirectionsX.resize(m_AmountOfPixels);
+	m_RayDirectionsY.resize(m_AmountOfPixels);
+	m_RayDirectionsZ.resize(m_AmountOfPixels);
+	std::for_each(std::execution::par, m_ImageVerticalIterator.begin(), m_ImageVerticalIterator.end(), [&](uint32_t py)
+		{
+			const float cy = (1 - 2 * (py + 0.5f) / m_Height) * fovFactor;
+			float* const pX{ m_RayDirectionsX.data() + py * m_Width };
+			float* const pY{ m_RayDirectionsY.data() + py * m_Width };
+			float* const pZ{ m_RayDirectionsZ.data() + py * m_Width };
+
+			//Same math as cameraToWorld.TransformVector({ cx, cy, 1 }).Normalized(), written out per component
+			for (int px = 0; px < m_Width; ++px)
+			{
+				const float cx = (2.f * (px + 0.5f) / m_Width - 1.f) * m_AspectRatio * fovFactor;
+				const float x{ right.x * cx + up.x * cy + forward.x };
+				const float y{ right.y * cx + up.y * cy + forward.y };
+				const float z{ right.z * cx + up.z * cy + forward.z };
+				const float length{ sqrtf(x * x + y * y + z * z) };
+				pX[px] = x / length;
+				pY[px] = y / length;
+				pZ[px] = z / length;
+			}
+		});
+
+	m_RayDirectionsForward = forward;
+	m_RayDirectionsFov = fovFactor;
+	m_RayDirectionsValid = true;
+}
+
+Vector3 Renderer::GetRayDirection(uint32_t pixelIndex, float offsetX, float offsetY, const Matrix& cameraToWorld, float fovFactor) const
+{
+	const Vector3 right{ cameraToWorld.GetAxisX() };
+	const Vector3 up{ cameraToWorld.GetAxisY() };
+	const Vector3 forward{ cameraToWorld.GetAxisZ() };
+	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+	const float cx = (2.f * (px + offsetX) / m_Width - 1.f) * m_AspectRatio * fovFactor;
+	const float cy = (1 - 2 * (py + offsetY) / m_Height) * fovFactor;
+	return Vector3{ right * cx + up * cy + forward }.Normalized();
+}
+
+bool Renderer::UpdateMeshBounds(const Scene* pScene)
+{
+	const auto& meshes{ pScene->GetTriangleMeshGeometries() };
+	const bool isSameMeshSet{ meshes.data() == m_pMeshSource && meshes.size() == m_MeshBounds.size() };
+	m_pMeshSource = meshes.data();
+	m_MeshBounds.resize(meshes.size());
+	m_MeshVersions.resize(meshes.size());
+	m_ChangedBounds.clear();
+	for (size_t meshIndex{}; meshIndex < meshes.size(); ++meshIndex)
+	{
+		const TriangleMesh& mesh{ meshes[meshIndex] };
+		WorldBounds& bounds{ m_MeshBounds[meshIndex] };
+		if (isSameMeshSet && mesh.transformVersion == m_MeshVersions[meshIndex])
+			continue;
+
+		//Pixels change both where the mesh was and where it is now
+		m_ChangedBounds.push_back({ Vector3::Min(bounds.minAABB, mesh.transformedMinAABB), Vector3::Max(bounds.maxAABB, mesh.transformedMaxAABB) });
+		bounds = { mesh.transformedMinAABB, mesh.transformedMaxAABB };
+		m_MeshVersions[meshIndex] = mesh.transformVersion;
+	}
+	return isSameMeshSet;
+}
+
+void Renderer::FindChangedTiles(const Scene* pScene, const Matrix& cameraToWorld, float fovFactor)
+{
+	std::fill(m_IsTileChanged.begin(), m_IsTileChanged.end(), uint8_t{ 0 });
+
+	const Matrix worldToCamera{ Matrix::InverseRigid(cameraToWorld) };
+	//Ambient occlusion also changes on the surfaces within its radius of a moved mesh
+	const bool isOccludingAmbient{ m_CurrentLightMode == LightingMode::AmbientOcclusion ||
+		(m_CurrentLightMode == LightingMode::Combined && m_AmbientRadiance > 0.f) };
+	const float occlusionRadius{ isOccludingAmbient ? m_AmbientOcclusionRadius : 0.f };
+	const Vector3 occlusionExtent{ occlusionRadius, occlusionRadius, occlusionRadius };
+	for (const WorldBounds& bounds : m_ChangedBounds)
+		MarkProjectedBounds({ bounds.minAABB - occlusionExtent, bounds.maxAABB + occlusionExtent }, worldToCamera, fovFactor);
+
+	//Any other surface changes when a moved mesh starts or stops shadowing it, the hits of those tiles are still valid
+	if (m_ShadowsEnabled && !m_ChangedBounds.empty())
+	{
+		ForEachTile([&](uint32_t tileIndex)
+			{
+				if (m_IsTileChanged[tileIndex])
+					return;
+				bool isChanged{};
+				ForEachPixelInTile(tileIndex, [&](uint32_t pixelIndex)
+					{
+						isChanged = isChanged || IsShadowedByChangedMesh(pScene, m_PrimaryHits[pixelIndex]);
+					});
+				m_IsTileChanged[tileIndex] = isChanged;
+			});
+	}
+
+	m_ChangedTileOrder.clear();
+	for (uint32_t tileIndex : m_TileOrder)
+	{
+		if (m_IsTileChanged[tileIndex])
+			m_ChangedTileOrder.push_back(tileIndex);
+	}
+}
+
+void Renderer::MarkProjectedBounds(const WorldBounds& bounds, const Matrix& worldToCamera, float fovFactor)
+{
+	//Screen rectangle of the 8 corners, the inverse of the primary ray setup
+	float minX{ FLT_MAX }, minY{ FLT_MAX }, maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+	for (int corner{}; corner < 8; ++corner)
+	{
+		const Vector3 viewCorner{ worldToCamera.TransformPoint(
+			corner & 1 ? bounds.maxAABB.x : bounds.minAABB.x,
+			corner & 2 ? bounds.maxAABB.y : bounds.minAABB.y,
+			corner & 4 ? bounds.maxAABB.z : bounds.minAABB.z) };
+		if (viewCorner.z <= 0.f)
+		{
+			//Reaches behind the camera, the projection is unbounded
+			std::fill(m_IsTileChanged.begin(), m_IsTileChanged.end(), uint8_t{ 1 });
+			return;
+		}
+		const float x{ (viewCorner.x / (viewCorner.z * m_AspectRatio * fovFactor) + 1.f) * 0.5f * m_Width };
+		const float y{ (1.f - viewCorner.y / (viewCorner.z * fovFactor)) * 0.5f * m_Height };
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+	}
+	if (maxX < 0.f || maxY < 0.f || minX >= m_Width || minY >= m_Height)
+		return;
+
+	//One pixel of margin for rounding
+	const int firstTileX{ int(std::max(minX - 1.f, 0.f)) / TILE_SIZE };
+	const int firstTileY{ int(std::max(minY - 1.f, 0.f)) / TILE_SIZE };
+	const int lastTileX{ int(std::min(maxX + 1.f, m_Width - 1.f)) / TILE_SIZE };
+	const int lastTileY{ int(std::min(maxY + 1.f, m_Height - 1.f)) / TILE_SIZE };
+	for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+	{
+		for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+			m_IsTileChanged[tileX + tileY * m_TilesX] = 1;
+	}
+}
+
+bool Renderer::IsShadowedByChangedMesh(const Scene* pScene, const HitRecord& hit) const
+{
+	if (!hit.didHit)
+		return false;
+
+	//Conservative, the segment towards the light only has to cross the bounds of a moved mesh
+	for (const Light& light : pScene->GetLights())
+	{
+		Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, hit.origin) };
+		const float lightDistance{ lightDirection.Normalize() };
+		if (light.influenceRadius > 0.f && lightDistance > light.influenceRadius)
+			continue;
+
+		const Ray shadowRay{ hit.origin, lightDirection, 0.f, lightDistance };
+		const Vector3 invDirection{ 1.f / lightDirection.x, 1.f / lightDirection.y, 1.f / lightDirection.z };
+		//Segments to the rest of an area light are the one to its centre shifted by less than its extent
+		const Vector3 lightExtent{ LightUtils::GetHalfExtent(light) };
+		for (const WorldBounds& bounds : m_ChangedBounds)
+		{
+			float tNear{};
+			if (GeometryUtils::AABB_Slab(bounds.minAABB - lightExtent, bounds.maxAABB + lightExtent, shadowRay, invDirection, tNear))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool Renderer::TryReuseShading(const HitRecord& hit, uint32_t pixelIndex, ColorRGB& color) const
+{
+	//A rotating subset of the pixels is shaded again every frame so view dependent highlights catch up
+	if ((HashPCG(pixelIndex) + m_FrameIndex) % TEMPORAL_REFRESH_INTERVAL == 0)
+		return false;
+
+	//Project the surface point into last frame's image, inverting the primary ray setup
+	const Vector3 previousView{ m_PreviousWorldToCamera.TransformPoint(hit.origin) };
+	if (previousView.z <= 0.f)
+		return false;
+	const float previousX{ (previousView.x / (previousView.z * m_AspectRatio * m_PreviousFovFactor) + 1.f) * 0.5f * m_Width };
+	const float previousY{ (1.f - previousView.y / (previousView.z * m_PreviousFovFactor)) * 0.5f * m_Height };
+	if (previousX < 0.f || previousY < 0.f || previousX >= m_Width || previousY >= m_Height)
+		return false;
+
+	//Only reuse it when last frame saw the same surface there, anything else was disoccluded
+	const TemporalSample& sample{ m_PreviousTemporalSamples[uint32_t(previousX) + uint32_t(previousY) * m_Width] };
+	if (!sample.didHit || sample.materialIndex != hit.materialIndex ||
+		Vector3::Dot(sample.normal, hit.normal) < TEMPORAL_MIN_NORMAL_COS ||
+		(sample.position - hit.origin).SqrMagnitude() > Square(TEMPORAL_MAX_DISTANCE_RATIO * previousView.z))
+		return false;
+
+	color = sample.color;
+	return true;
+}
+
+void Renderer::RenderWavefront(const Scene* pScene, const Vector3& cameraOrigin)
+{
+	//Primary pass, every tile queues one record per light that can reach its pixels
+	m_TileShadowRays.resize(m_TileOrder.size());
+	m_WavefrontColors.resize(m_AmountOfPixels);
+	ForEachTile([&](uint32_t tileIndex)
+		{
+			std::vector<ShadowRayRecord>& queue{ m_TileShadowRays[tileIndex] };
+			queue.clear();
+			ForEachPixelInTile(tileIndex, [&](uint32_t pixelIndex)
+				{
+					m_WavefrontColors[pixelIndex] = {};
+					const Vector3 rayDirection{ GetRayDirection(pixelIndex) };
+					HitRecord closestHit{};
+					if (m_UseLightClusters)
+						closestHit = m_PrimaryHits[pixelIndex];
+					else
+						pScene->GetClosestHit(Ray{ cameraOrigin, rayDirection }, closestHit);
+					if (!closestHit.didHit) return;
+
+					if (m_UseLightClusters)
+					{
+						QueueShadowRays(pScene, closestHit, rayDirection, pixelIndex, m_LightClusters.GetGlobalLights(), queue);
+						QueueShadowRays(pScene, closestHit, rayDirection, pixelIndex, m_LightClusters.GetLights(pixelIndex), queue);
+					}
+					else QueueShadowRays(pScene, closestHit, rayDirection, pixelIndex, m_AllLightIndices, queue);
+
+					//Secondary hits are shaded right away, only the primary hit's shadow rays go through the queue
+					const Sampler sampler{ m_SamplerType, pixelIndex % m_Width, pixelIndex / m_Width, 0 };
+					m_WavefrontColors[pixelIndex] = ShadeIndirect(pScene, closestHit, rayDirection, sampler);
+				});
+		});
+
+	//Counting sort of the traced rays by light and direction octant. Inside a bucket the rays keep the tile order,
+	//so rays next to each other in the stream also start close together
+	m_ShadowRayBuckets.assign(m_LightSourceCount * 8 + 1, 0);
+	for (const std::vector<ShadowRayRecord>& queue : m_TileShadowRays)
+	{
+		for (const ShadowRayRecord& record : queue)
+		{
+			if (record.isTraced) ++m_ShadowRayBuckets[GetShadowRayBucket(record) + 1];
+		}
+	}
+	std::partial_sum(m_ShadowRayBuckets.begin(), m_ShadowRayBuckets.end(), m_ShadowRayBuckets.begin());
+	m_ShadowRayOrder.resize(m_ShadowRayBuckets.back());
+	for (std::vector<ShadowRayRecord>& queue : m_TileShadowRays)
+	{
+		for (ShadowRayRecord& record : queue)
+		{
+			if (record.isTraced) m_ShadowRayOrder[m_ShadowRayBuckets[GetShadowRayBucket(record)]++] = &record;
+		}
+	}
+
+	//Trace the stream in fixed size batches, a batch mostly tests one light against one part of the scene
+	const uint32_t tracedCount{ static_cast<uint32_t>(m_ShadowRayOrder.size()) };
+	m_ShadowRayBatches.resize((tracedCount + SHADOW_RAY_BATCH_SIZE - 1) / SHADOW_RAY_BATCH_SIZE);
+	std::iota(m_ShadowRayBatches.begin(), m_ShadowRayBatches.end(), 0);
+	std::for_each(std::execution::par, m_ShadowRayBatches.begin(), m_ShadowRayBatches.end(), [&](uint32_t batchIndex)
+		{
+			Occluder* const pOccluders{ GetOccluderCache() };
+			const uint32_t first{ batchIndex * SHADOW_RAY_BATCH_SIZE };
+			const uint32_t last{ std::min(first + SHADOW_RAY_BATCH_SIZE, tracedCount) };
+			for (uint32_t orderIndex = first; orderIndex < last; ++orderIndex)
+			{
+				ShadowRayRecord& record{ *m_ShadowRayOrder[orderIndex] };
+				record.isVisible = !pScene->DoesHit(record.shadowRay, pOccluders[record.lightIndex]);
+			}
+		});
+
+	//Resolve per tile, a pixel's records are added in the same order ShadeLights adds them
+	ForEachTile([&](uint32_t tileIndex)
+		{
+			for (const ShadowRayRecord& record : m_TileShadowRays[tileIndex])
+			{
+				if (record.isVisible)
+					m_WavefrontColors[record.pixelIndex] += record.color;
+			}
+			ForEachPixelInTile(tileIndex, [&](uint32_t pixelIndex) { WritePixel(pixelIndex, m_WavefrontColors[pixelIndex]); });
+		});
+}
+
+void Renderer::QueueShadowRays(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t pixelIndex,
+	std::span<const uint32_t> lightIndices, std::vector<ShadowRayRecord>& queue) const
+{
+	FrameArena& arena{ FrameArena::Get() };
+	const FrameArena::Scope arenaScope{ arena };
+	float remainingLuminance{ 0.f };
+	for (const ShadowCandidate& candidate : GatherShadowCandidates(pScene, hit, rayDirection, lightIndices, arena, remainingLuminance))
+	{
+		//Same cutoff as ShadeLights, the weakest lights are queued as already lit
+		const bool isTraced{ m_ShadowCutoff <= 0.f || remainingLuminance >= m_ShadowCutoff };
+		if (isTraced) remainingLuminance -= candidate.luminance;
+		queue.push_back({ candidate.shadowRay, candidate.color, pixelIndex, candidate.lightIndex, isTraced, !isTraced });
+	}
+}
+
+uint32_t Renderer::GetShadowRayBucket(const ShadowRayRecord& record)
+{
+	const Vector3& direction{ record.shadowRay.direction };
+	const uint32_t octant{ uint32_t(direction.x < 0.f) | (uint32_t(direction.y < 0.f) << 1) | (uint32_t(direction.z < 0.f) << 2) };
+	return record.lightIndex * 8 + octant;
+}
+
+void Renderer::WritePixel(uint32_t pixelIndex, ColorRGB finalColor) const
+{
+	//Update Color in Buffer
+	finalColor.MaxToOne();
+	m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255),
+		static_cast<uint8_t>(finalColor.g * 255),
+		static_cast<uint8_t>(finalColor.b * 255));
+}
+
+ColorRGB Renderer::EvaluateLight(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Light& light, Ray& shadowRay) const
+{
+	const Vector3 lightRayIntersectPoint{ hit.origin + 0.00001f * hit.normal };
+	Vector3 lightRayDir{ LightUtils::GetDirectionToLight(light,lightRayIntersectPoint) };
+	const float lightRayDist{ lightRayDir.Normalize() };
+
+	shadowRay = Ray{ lightRayIntersectPoint, lightRayDir, 0.001f, lightRayDist };
+
+	return EvaluateLightDirection(pScene, hit, rayDirection, lightRayDir, LightUtils::GetRadiance(light, lightRayIntersectPoint));
+}
+
+ColorRGB Renderer::EvaluateLightDirection(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Vector3& lightDirection,
+	const ColorRGB& radiance) const
+{
+	const float lightDirCos{ Vector3::Dot(hit.normal,lightDirection) };
+
+	const auto& materials = pScene->GetMaterials();
+	switch (m_CurrentLightMode)
+	{
+	case LightingMode::Combined:
+	case LightingMode::PathTraced:
+		if (lightDirCos >= 0)
+			return radiance * lightDirCos * materials[hit.materialIndex].Shade(hit, lightDirection, -rayDirection);
+		break;
+	case LightingMode::ObservedArea:
+		if (lightDirCos >= 0)
+			return lightDirCos * ColorRGB{ 1, 1, 1 };
+		break;
+	case LightingMode::Radiance:
+		return radiance;
+	case LightingMode::BRDF:
+		if (lightDirCos >= 0)
+			return materials[hit.materialIndex].Shade(hit, lightDirection, -rayDirection);
+		break;
+	default:
+		break;
+	}
+	return {};
+}
+
+ColorRGB Renderer::ShadeAreaLight(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t lightIndex,
+	const Sampler& sampler, bool testVisibility) const
+{
+	const Vector3 shadowRayOrigin{ hit.origin + 0.00001f * hit.normal };
+	LightUtils::AreaLightSampler lightSampler{};
+	if (!lightSampler.Begin(pScene->GetLights()[lightIndex], shadowRayOrigin))
+		return {};
+	Occluder& occluder{ GetOccluderCache()[lightIndex] };
+
+	//The pixel's sample shifts the whole grid (Cranley-Patterson rotation), a hash of the light keeps the lights
+	//of one pixel from sharing the shift. The jitter inside the strata is hashed from the same values
+	const uint32_t lightSeed{ HashPCG(lightIndex + 1) };
+	const float offsetU{ sampler.Get(SampleDimension::AreaLightU) + (lightSeed >> 8) * (1.f / 16777216.f) };
+	const float offsetV{ sampler.Get(SampleDimension::AreaLightV) + (HashPCG(lightSeed) >> 8) * (1.f / 16777216.f) };
+	uint32_t jitterState{ HashPCG(lightSeed ^ uint32_t(offsetU * 16777216.f) ^ (uint32_t(offsetV * 16777216.f) << 7)) };
+	const auto nextJitter{ [&jitterState]
+		{
+			jitterState = HashPCG(jitterState);
+			return (jitterState >> 8) * (1.f / 16777216.f);
+		} };
+
+	const int strata{ m_AreaLightStrata };
+	const int half{ strata / 2 };
+	const float strataSize{ 1.f / strata };
+	ColorRGB litColor{};
+	int litCount{}, occludedCount{};
+	const auto takeSample{ [&](int stratumX, int stratumY, bool isTraced)
+		{
+			const float u{ (stratumX + nextJitter()) * strataSize + offsetU };
+			const float v{ (stratumY + nextJitter()) * strataSize + offsetV };
+			Vector3 lightDirection{};
+			float lightDistance{};
+			ColorRGB radiance{};
+			lightSampler.Sample(u - floorf(u), v - floorf(v), lightDirection, lightDistance, radiance);
+
+			//Only pay for the shadow ray when the sample can actually add something
+			const ColorRGB color{ EvaluateLightDirection(pScene, hit, rayDirection, lightDirection, radiance) };
+			if (color.GetLuminance() <= 0.f) return;
+			if (isTraced && pScene->DoesHit(Ray{ shadowRayOrigin, lightDirection, 0.001f, lightDistance }, occluder))
+				++occludedCount;
+			else
+			{
+				++litCount;
+				litColor += color;
+			}
+		} };
+
+	//One random stratum of every quadrant is traced first
+	int firstStrata[4]{};
+	for (int quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		const int stratumX{ (quadrant & 1) * half + std::min(int(nextJitter() * half), half - 1) };
+		const int stratumY{ (quadrant >> 1) * half + std::min(int(nextJitter() * half), half - 1) };
+		firstStrata[quadrant] = stratumX + stratumY * strata;
+		takeSample(stratumX, stratumY, testVisibility);
+	}
+	if (occludedCount == 4)
+		return {};
+
+	//Evaluating a sample costs far less than its shadow ray, so outside the penumbra every stratum is still shaded
+	//and only the shadow rays are skipped. A quadrant whose sample added nothing could hide a penumbra as well
+	const bool isPenumbra{ testVisibility && litCount < 4 };
+	for (int stratum = 0; stratum < strata * strata; ++stratum)
+	{
+		if (std::find(std::begin(firstStrata), std::end(firstStrata), stratum) != std::end(firstStrata)) continue;
+		takeSample(stratum % strata, stratum / strata, isPenumbra);
+	}
+	return litColor * (strataSize * strataSize);
+}
+
+ColorRGB Renderer::ShadeLight(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t lightIndex, const Sampler& sampler) const
+{
+	if (LightUtils::IsAreaLight(pScene->GetLights()[lightIndex]))
+		return ShadeAreaLight(pScene, hit, rayDirection, lightIndex, sampler, m_ShadowsEnabled);
+
+	Ray shadowRay{};
+	const ColorRGB lightColor{ EvaluateLight(pScene, hit, rayDirection, pScene->GetLights()[lightIndex], shadowRay) };
+
+	//Only pay for the shadow ray when the light can actually add something
+	if (lightColor.GetLuminance() <= 0.f || (m_ShadowsEnabled && pScene->DoesHit(shadowRay, GetOccluderCache()[lightIndex])))
+		return {};
+	return lightColor;
+}
+
+Occluder* Renderer::GetOccluderCache() const
+{
+	//One cache per thread so no locking is needed, neighbouring pixels mostly run on the same thread
+	static thread_local std::vector<Occluder> lastOccluders{};
+	if (lastOccluders.size() < m_LightSourceCount)
+		lastOccluders.resize(m_LightSourceCount);
+	return lastOccluders.data();
+}
+
+std::span<Renderer::ShadowCandidate> Renderer::GatherShadowCandidates(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection,
+	std::span<const uint32_t> lightIndices, FrameArena& arena, float& totalLuminance) const
+{
+	//Evaluate every light unshadowed first, lights that cannot contribute (facing away, out of range) never get a shadow ray
+	const auto& lights = pScene->GetLights();
+	ShadowCandidate* const pCandidates{ arena.Allocate<ShadowCandidate>(lightIndices.size()) };
+	size_t candidateCount{};
+	for (uint32_t lightIndex : lightIndices)
+	{
+		ShadowCandidate candidate{};
+		candidate.lightIndex = lightIndex;
+		candidate.color = EvaluateLight(pScene, hit, rayDirection, lights[lightIndex], candidate.shadowRay);
+		candidate.luminance = candidate.color.GetLuminance();
+		//The centre of an area light only orders it, part of the light can reach the hit while the centre does not.
+		//Its color is estimated over the whole surface by ShadeAreaLight when it is shaded
+		if (candidate.luminance <= 0.f && !LightUtils::IsAreaLight(lights[lightIndex])) continue;
+
+		totalLuminance += candidate.luminance;
+		std::construct_at(pCandidates + candidateCount++, candidate);
+	}
+	const std::span<ShadowCandidate> candidates{ pCandidates, candidateCount };
+
+	//Brightest lights first so the cutoff only skips the weakest ones
+	if (m_ShadowCutoff > 0.f)
+	{
+		std::sort(candidates.begin(), candidates.end(),
+			[](const ShadowCandidate& a, const ShadowCandidate& b) { return a.luminance > b.luminance; });
+	}
+	return candidates;
+}
+
+ColorRGB Renderer::ShadeLights(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, std::span<const uint32_t> lightIndices,
+	const Sampler& sampler) const
+{
+	ColorRGB finalColor{};
+	if (!m_ShadowsEnabled)
+	{
+		for (uint32_t lightIndex : lightIndices)
+			finalColor += ShadeLight(pScene, hit, rayDirection, lightIndex, sampler);
+		return finalColor;
+	}
+
+	FrameArena& arena{ FrameArena::Get() };
+	const FrameArena::Scope arenaScope{ arena };
+	float remainingLuminance{ 0.f };
+	const std::span<const ShadowCandidate> candidates{ GatherShadowCandidates(pScene, hit, rayDirection, lightIndices, arena, remainingLuminance) };
+	Occluder* const pOccluders{ GetOccluderCache() };
+
+	for (const ShadowCandidate& candidate : candidates)
+	{
+		//Whatever is left cannot change the pixel noticeably, count it as lit instead of tracing it.
+		//Without a cutoff every light is traced, rounding in the remaining sum must not skip the last ones
+		const bool isTraced{ m_ShadowCutoff <= 0.f || remainingLuminance >= m_ShadowCutoff };
+		if (isTraced) remainingLuminance -= candidate.luminance;
+		if (LightUtils::IsAreaLight(pScene->GetLights()[candidate.lightIndex]))
+			finalColor += ShadeAreaLight(pScene, hit, rayDirection, candidate.lightIndex, sampler, isTraced);
+		else if (!isTraced || !pScene->DoesHit(candidate.shadowRay, pOccluders[candidate.lightIndex]))
+			finalColor += candidate.color;
+	}
+	return finalColor;
+}
+
+ColorRGB Renderer::ShadeHit(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t pixelIndex, const Sampler& sampler) const
+{
+	if (m_CurrentLightMode == LightingMode::PathTraced)
+		return TracePath(pScene, hit, rayDirection, sampler);
+	if (m_CurrentLightMode == LightingMode::AmbientOcclusion)
+	{
+		const float ambientOcclusion{ GetAmbientOcclusion(pScene, hit, rayDirection, sampler) };
+		return ColorRGB{ ambientOcclusion, ambientOcclusion, ambientOcclusion };
+	}
+
+	ColorRGB finalColor{};
+
+	if (m_UseLightClusters)
+	{
+		finalColor += ShadeLights(pScene, hit, rayDirection, m_LightClusters.GetGlobalLights(), sampler);
+		finalColor += ShadeLights(pScene, hit, rayDirection, m_LightClusters.GetLights(pixelIndex), sampler);
+	}
+	else finalColor = ShadeDirect(pScene, hit, rayDirection, sampler);
+
+	finalColor += ShadeIndirect(pScene, hit, rayDirection, sampler);
+	return finalColor;
+}
+
+ColorRGB Renderer::ShadeIndirect(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const
+{
+	ColorRGB finalColor{};
+	if (m_BounceLimit > 0)
+		finalColor += TraceBounces(pScene, hit, rayDirection, sampler);
+
+	if (m_AmbientRadiance > 0.f && m_CurrentLightMode == LightingMode::Combined)
+	{
+		//The BRDF towards the normal stands in for its integral over the open part of the hemisphere
+		ColorRGB ambient{ pScene->GetMaterials()[hit.materialIndex].Shade(hit, hit.normal, -rayDirection) };
+		ambient *= m_AmbientRadiance * PI * GetAmbientOcclusion(pScene, hit, rayDirection, sampler);
+		finalColor += ambient;
+	}
+	return finalColor;
+}
+
+float Renderer::GetAmbientOcclusion(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const
+{
+	//Rays leave on the side the surface is seen from
+	const Vector3 normal{ Vector3::Dot(hit.normal, rayDirection) > 0.f ? -hit.normal : hit.normal };
+
+	//Jittered grid shifted by the sampler, the accumulation covers the hemisphere evenly over the frames
+	const float offsetU{ sampler.Get(SampleDimension::AmbientOcclusionU) };
+	const float offsetV{ sampler.Get(SampleDimension::AmbientOcclusionV) };
+	uint32_t jitterState{ HashPCG(std::bit_cast<uint32_t>(offsetU) ^ HashPCG(std::bit_cast<uint32_t>(offsetV))) };
+	const int strata{ m_AmbientOcclusionStrata };
+	const float strataSize{ 1.f / strata };
+	std::array<Vector3, MAX_AMBIENT_OCCLUSION_STRATA * MAX_AMBIENT_OCCLUSION_STRATA> directions{};
+	size_t directionCount{};
+	for (int stratumY = 0; stratumY < strata; ++stratumY)
+	{
+		for (int stratumX = 0; stratumX < strata; ++stratumX)
+		{
+			const float u{ (stratumX + RandomFloat(jitterState)) * strataSize + offsetU };
+			const float v{ (stratumY + RandomFloat(jitterState)) * strataSize + offsetV };
+			directions[directionCount++] = BRDF::SampleDirection_Cosine(normal, u - floorf(u), v - floorf(v));
+		}
+	}
+
+	const Vector3 origin{ hit.origin + normal * BOUNCE_RAY_OFFSET };
+	const uint32_t occludedCount{ pScene->CountOccludedRays(origin, { directions.data(), directionCount }, m_AmbientOcclusionRadius) };
+	return 1.f - float(occludedCount) / directionCount;
+}
+
+ColorRGB Renderer::ShadeDirect(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const
+{
+	if (!m_ManyLightsEnabled)
+		return ShadeLights(pScene, hit, rayDirection, m_AllLightIndices, sampler);
+
+	ColorRGB finalColor{};
+	for (uint32_t lightIndex : m_LightTree.GetDirectionalLights())
+		finalColor += ShadeLight(pScene, hit, rayDirection, lightIndex, sampler);
+
+	//Radiance mode also counts lights behind the surface, a zero normal turns off the tree's orientation test
+	const Vector3 cullNormal{ m_CurrentLightMode == LightingMode::Radiance ? Vector3{} : hit.normal };
+	for (int sample = 0; sample < MANY_LIGHTS_SAMPLE_COUNT; ++sample)
+	{
+		uint32_t lightIndex{};
+		float pdf{};
+		const float u{ sampler.Get(SampleDimension::LightSelection, sample, MANY_LIGHTS_SAMPLE_COUNT) };
+		if (!m_LightTree.Sample(hit.origin, cullNormal, u, lightIndex, pdf))
+			break;
+
+		//Dividing by the selection probability keeps the estimate unbiased
+		const ColorRGB lightColor{ ShadeLight(pScene, hit, rayDirection, lightIndex, sampler) };
+		finalColor += lightColor * (1.f / (pdf * MANY_LIGHTS_SAMPLE_COUNT));
+	}
+	return finalColor;
+}
+
+ColorRGB Renderer::TraceBounces(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const
+{
+	//Only the combined mode shows reflected light, the other modes visualize one term of the direct light
+	if (m_CurrentLightMode != LightingMode::Combined)
+		return {};
+
+	struct PendingRay
+	{
+		Ray ray{};
+		ColorRGB throughput{};
+		int depth{};
+	};
+	//Depth first, a hit pushes at most two rays and pops one, so the stack never holds more than one ray per level plus one
+	std::array<PendingRay, MAX_BOUNCES + 1> pending{};
+	size_t pendingCount{};
+
+	const auto& materials{ pScene->GetMaterials() };
+	//The first bounce is stratified by the sampler, deeper ones hash on from it
+	const float firstU{ sampler.Get(SampleDimension::BounceU) };
+	const float firstV{ sampler.Get(SampleDimension::BounceV) };
+	uint32_t randomState{ HashPCG(std::bit_cast<uint32_t>(firstU) ^ HashPCG(std::bit_cast<uint32_t>(firstV))) };
+
+	const auto pushBounces{ [&](const HitRecord& from, const Vector3& direction, const ColorRGB& throughput, int depth, float u1, float u2)
+		{
+			MaterialBounce bounces[2]{};
+			const int bounceCount{ materials[from.materialIndex].GetBounces(from, -direction, u1, u2, bounces) };
+			for (int bounce = 0; bounce < bounceCount; ++bounce)
+			{
+				ColorRGB weight{ bounces[bounce].weight };
+				weight *= throughput;
+				//Weak rays survive with a probability proportional to what they carry and make up for the others
+				const float strength{ std::max(weight.r, std::max(weight.g, weight.b)) };
+				if (strength <= 0.f) continue;
+				if (strength < BOUNCE_MIN_THROUGHPUT)
+				{
+					const float survival{ strength / BOUNCE_MIN_THROUGHPUT };
+					if (RandomFloat(randomState) >= survival) continue;
+					weight *= 1.f / survival;
+				}
+
+				//Offset to the side of the surface the ray leaves on so it does not hit where it started
+				const Vector3& bounceDirection{ bounces[bounce].direction };
+				const float side{ Vector3::Dot(bounceDirection, from.normal) >= 0.f ? BOUNCE_RAY_OFFSET : -BOUNCE_RAY_OFFSET };
+				pending[pendingCount++] = { Ray{ from.origin + from.normal * side, bounceDirection }, weight, depth };
+			}
+		} };
+
+	pushBounces(hit, rayDirection, colors::White, 1, firstU, firstV);
+	ColorRGB finalColor{};
+	uint64_t rayCount{};
+	while (pendingCount > 0)
+	{
+		const PendingRay current{ pending[--pendingCount] };
+		++rayCount;
+		HitRecord bounceHit{};
+		pScene->GetClosestHit(current.ray, bounceHit);
+		if (!bounceHit.didHit) continue;
+
+		ColorRGB color{ ShadeDirect(pScene, bounceHit, current.ray.direction, sampler) };
+		color *= current.throughput;
+		finalColor += color;
+		if (current.depth < m_BounceLimit)
+		{
+			const float u1{ RandomFloat(randomState) }, u2{ RandomFloat(randomState) };
+			pushBounces(bounceHit, current.ray.direction, current.throughput, current.depth + 1, u1, u2);
+		}
+	}
+	m_SecondaryRayCount.fetch_add(rayCount, std::memory_order_relaxed);
+	return finalColor;
+}
+
+ColorRGB Renderer::TracePath(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const
+{
+	//Lights cannot be hit, only next event estimation finds them, so every vertex adds its direct light and nothing is counted twice
+	const auto& materials{ pScene->GetMaterials() };
+	float u1{ sampler.Get(SampleDimension::BounceU) };
+	float u2{ sampler.Get(SampleDimension::BounceV) };
+	float uLobe{ sampler.Get(SampleDimension::PathLobe) };
+	uint32_t randomState{ HashPCG(std::bit_cast<uint32_t>(u1) ^ HashPCG(std::bit_cast<uint32_t>(uLobe))) };
+
+	HitRecord vertex{ hit };
+	Vector3 direction{ rayDirection };
+	ColorRGB throughput{ colors::White };
+	ColorRGB finalColor{};
+	uint64_t rayCount{};
+	for (int depth = 1;; ++depth)
+	{
+		//Every vertex picks its lights and light points with its own dimensions, reusing the first vertex's would correlate them along the path
+		ColorRGB directLight{ ShadeDirect(pScene, vertex, direction, sampler.ForVertex(depth - 1)) };
+		directLight *= throughput;
+		finalColor += directLight;
+		if (depth >= MAX_PATH_LENGTH)
+			break;
+
+		//Candidate bounces of every lobe, one of them is followed with a probability proportional to what it carries
+		const Material& material{ materials[vertex.materialIndex] };
+		MaterialBounce specularBounces[2]{};
+		MaterialBounce bounces[3]{};
+		int bounceCount{ material.GetBounces(vertex, -direction, u1, u2, specularBounces) };
+		std::copy_n(specularBounces, bounceCount, bounces);
+		if (material.GetDiffuseBounce(vertex, -direction, u1, u2, bounces[bounceCount]))
+			++bounceCount;
+		float strengths[3]{};
+		float totalStrength{};
+		for (int bounce = 0; bounce < bounceCount; ++bounce)
+		{
+			const ColorRGB& weight{ bounces[bounce].weight };
+			strengths[bounce] = std::max(weight.r, std::max(weight.g, weight.b));
+			totalStrength += strengths[bounce];
+		}
+		if (totalStrength <= 0.f)
+			break;
+		int picked{};
+		for (float threshold{ uLobe * totalStrength }; picked < bounceCount - 1 && threshold >= strengths[picked]; ++picked)
+			threshold -= strengths[picked];
+		if (strengths[picked] <= 0.f)
+			break;
+
+		ColorRGB weight{ bounces[picked].weight };
+		weight *= totalStrength / strengths[picked];
+		throughput *= weight;
+		//Paths that carry little light end early, the surviving ones make up for them
+		if (depth >= PATH_ROULETTE_DEPTH)
+		{
+			const float survival{ std::min(1.f, std::max(throughput.r, std::max(throughput.g, throughput.b))) };
+			if (RandomFloat(randomState) >= survival)
+				break;
+			throughput *= 1.f / survival;
+		}
+
+		const Vector3& bounceDirection{ bounces[picked].direction };
+		const float side{ Vector3::Dot(bounceDirection, vertex.normal) >= 0.f ? BOUNCE_RAY_OFFSET : -BOUNCE_RAY_OFFSET };
+		const Ray ray{ vertex.origin + vertex.normal * side, bounceDirection };
+		++rayCount;
+		HitRecord nextVertex{};
+		pScene->GetClosestHit(ray, nextVertex);
+		if (!nextVertex.didHit)
+			break;
+		vertex = nextVertex;
+		direction = bounceDirection;
+
+		u1 = RandomFloat(randomState);
+		u2 = RandomFloat(randomState);
+		uLobe = RandomFloat(randomState);
+	}
+	m_SecondaryRayCount.fetch_add(rayCount, std::memory_order_relaxed);
+	return finalColor;
+}
+
+void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, const Matrix cameraToWorld, const Vector3 cameraOrigin) const
+{
+	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+
+	float rx{ px + 0.5f }, ry{ py + 0.5f };
+	float cx{ 2.f * (rx / float(m_Width) - 1.f)* m_AspectRatio * fov };
+	float cy{ 1 - (2 * (ry / float(m_Height))) * fov };
+
+	Vector3 rayDirection{};
+	rayDirection = Vector3{ cx, cy ,1 };
+	rayDirection = cameraToWorld.TransformVector(rayDirection);
+	rayDirection.Normalize();
+	Ray hitRay{ cameraOrigin, rayDirection };
+	ColorRGB finalColor{};
+	HitRecord closestHit{};
+	pScene->GetClosestHit(hitRay, closestHit);
+	if (closestHit.didHit)
+	{
+		finalColor = ShadeHit(pScene, closestHit, rayDirection, pixelIndex, Sampler{ m_SamplerType, px, py, 0 });
 		//Update Color in Buffer
 		finalColor.MaxToOne();
 	}
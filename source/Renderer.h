@@ -1,7 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <span>
+#include <string>
 #include "Utils.h"
+#include "LightTree.h"
+#include "LightClusterGrid.h"
+#include "FrameArena.h"
+#include "Sampler.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -9,6 +17,7 @@ struct SDL_Surface;
 namespace dae
 {
 	class Scene;
+	struct RenderCheckpoint;
 
 	class Renderer final
 	{
@@ -21,36 +30,417 @@ namespace dae
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
+		void Render(Scene* pScene);
+
+		//Tile distribution, tiles are TILE_SIZE squares numbered row by row.
+		//RenderTiles only traces the given tiles and does not present them
+		static constexpr int TILE_SIZE{ 16 };
+		static constexpr int TILE_PIXEL_COUNT{ TILE_SIZE * TILE_SIZE };
+		//The clusters of a deadline tile are rebuilt by its tile index
+		static_assert(TILE_SIZE == LightClusterGrid::TILE_SIZE);
+		//In progressive modes sampleIndex is the coordinator's accumulated frame, the tiles take that sample of every pixel
+		//instead of accumulating here, other processes render the same pixels in other frames
+		void RenderTiles(Scene* pScene, std::span<const uint32_t> tiles, uint32_t sampleIndex = 0);
+		//Frame of the coordinator of a distributed render, returns the sample index its tiles are rendered with
+		uint32_t BeginDistributedFrame(Scene* pScene);
+		//Averages the samples of the written tiles into the accumulation, call once all tiles are written
+		void EndDistributedFrame();
+		uint32_t GetTileCount() const;
+		std::span<const uint32_t> GetTileOrder() const { return m_TileOrder; }
+		//Tile pixels as 0xRRGGBB, TILE_SIZE per row. Pixels outside the image read as 0 and are not written.
+		//In progressive modes every pixel is its unclamped sample as three floats, so averaging keeps the energy above one
+		static uint32_t GetTileWordCount() { return IsProgressive() ? 3 * TILE_PIXEL_COUNT : TILE_PIXEL_COUNT; }
+		void ReadTile(uint32_t tileIndex, std::span<uint32_t> pixels) const;
+		void WriteTile(uint32_t tileIndex, std::span<const uint32_t> pixels);
+		void PresentFrame();
 
 		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, const Matrix cameraToWorld, const Vector3 cameraOrigin) const;
 
 		bool SaveBufferToImage() const;
 
-		static void ToggleShadow();
-		static void ToggleLightMode();
-	private:
+		//Renders one image of any size into a binary PPM file without going through the window. Tiles are traced a row
+		//at a time straight into the memory mapped file, so memory use grows with the width but not with the image size.
+		//Progressive modes average sampleCount samples per pixel, the others take one
+		bool RenderStill(Scene* pScene, int width, int height, const std::string& filename, uint32_t sampleCount = 1);
+
+		//Frames averaged into the image shown in progressive modes, every pixel has this many samples
+		uint32_t GetAccumulatedFrames() const { return m_AccumulatedFrames; }
+		//Copies the accumulation together with the camera and settings it belongs to, false when nothing is accumulated
+		bool CaptureCheckpoint(Scene* pScene, RenderCheckpoint& checkpoint) const;
+		//Restores camera, settings and accumulation so the next frame continues where the checkpoint stopped.
+		//False if it was rendered at another resolution or with other lights
+		bool ResumeCheckpoint(Scene* pScene, const RenderCheckpoint& checkpoint);
 
 		enum class LightingMode
 		{
 			ObservedArea, //Lambert cosine law
 			Radiance, //Incident Radiance
 			BRDF, //Scattering of light
-			Combined
+			Combined,
+			PathTraced, //Global illumination, one path per pixel and frame averaged over the frames
+			AmbientOcclusion, //Share of the hemisphere not blocked within the ambient occlusion radius
+			Count
 		};
 
+		static void ToggleShadow();
+		static void ToggleLightMode();
+		static void SetLightMode(LightingMode mode);
+		static LightingMode GetLightMode() { return m_CurrentLightMode; }
+		//Many lights mode and path tracing average frames instead of showing each one
+		static bool IsProgressive() { return m_ManyLightsEnabled || m_CurrentLightMode == LightingMode::PathTraced; }
+		static void ToggleManyLights();
+		static void ToggleLightCulling();
+		static void ToggleWavefront();
+		static void ToggleTemporalReuse();
+		static void ToggleChangedTiles();
+		static void ToggleDeadline();
+		//Cycles through the random sequences of many lights mode
+		static void ToggleSampler();
+		static void SetSamplerType(SamplerType type);
+		//Shadow rays per area light and hit, rounded to a square grid with an even side
+		static void SetAreaLightSamples(int samples);
+		//Reflection and refraction rays, bounces is the deepest level a pixel follows them to, 0 turns them off
+		static void SetMaxBounces(int bounces);
+		static void ToggleBounces();
+		static bool AreBouncesEnabled() { return m_BouncesEnabled; }
+		//Secondary rays a frame may trace, the depth drops a level while frames go over it. 0 leaves the depth alone
+		static void SetRayBudget(uint32_t rays);
+		//Hemisphere rays per hit for ambient occlusion, rounded to a square grid
+		static void SetAmbientOcclusionSamples(int samples);
+		//Length of the ambient occlusion rays, only geometry this close darkens a hit
+		static void SetAmbientOcclusionRadius(float distance);
+		//Light from every direction that the combined mode adds where ambient occlusion lets it through, 0 turns it off
+		static void SetAmbientRadiance(float radiance);
+		//Depth the secondary rays currently go to, 0 when they are off
+		static int GetBounceLimit() { return m_BounceLimit; }
+		//Secondary rays traced by the last frame or still, reflection bounces and path segments alike
+		uint64_t GetSecondaryRayCount() const { return m_LastSecondaryRayCount; }
+		//Time a frame may take in deadline mode
+		static void SetFrameBudget(float milliseconds);
+		//Stop tracing shadow rays for a hit once the lights left could add less than cutoff, 0 traces all of them
+		static void SetShadowCutoff(float cutoff);
+
+		//Toggles that change the image, processes rendering tiles of the same frame have to agree on them
+		struct Settings
+		{
+			uint8_t lightMode{};
+			bool shadowsEnabled{};
+			bool manyLightsEnabled{};
+			bool lightCullingEnabled{};
+			SamplerType samplerType{};
+			uint8_t areaLightStrata{};
+			uint8_t maxBounces{};
+			uint8_t ambientOcclusionStrata{};
+			float shadowCutoff{};
+			float ambientOcclusionRadius{};
+			float ambientRadiance{};
+		};
+		static Settings GetSettings();
+		static void ApplySettings(const Settings& settings);
+		//Whether settings read from a file or another process only hold values this build can apply
+		static bool AreSettingsValid(const Settings& settings);
+	private:
 		static LightingMode m_CurrentLightMode;
 		static bool m_ShadowsEnabled;
+		//Stochastic light selection through the light tree, converges over frames
+		static bool m_ManyLightsEnabled;
+		//Only shade the bounded point lights whose influence radius reaches the pixel's cluster
+		static bool m_LightCullingEnabled;
+		//Queue all shadow rays during the primary pass and trace them afterwards as one stream sorted by light
+		static bool m_WavefrontEnabled;
+		//Reuse last frame's shading for surfaces that stay visible while the camera moves
+		static bool m_TemporalReuseEnabled;
+		//With a static camera only retrace the tiles that moving meshes cover or shadow, the rest keeps last frame's pixels
+		static bool m_ChangedTilesEnabled;
+		//Stop tracing tiles once the frame budget is used up, tiles that were not reached are filled in from what is cheap
+		static bool m_DeadlineEnabled;
+		static float m_FrameBudget; //Seconds
+		static SamplerType m_SamplerType;
+		//Area lights are sampled on a grid of this many strata squared
+		static uint8_t m_AreaLightStrata;
+		static bool m_BouncesEnabled;
+		static uint8_t m_MaxBounces;
+		//m_MaxBounces or less to stay in the ray budget, 0 when bounces are off
+		static uint8_t m_BounceLimit;
+		static uint32_t m_RayBudget;
+		//Ambient occlusion traces a grid of this many strata squared
+		static uint8_t m_AmbientOcclusionStrata;
+		static float m_AmbientOcclusionRadius;
+		static float m_AmbientRadiance;
+		static float m_ShadowCutoff;
+
+		//Light tree samples per pixel per frame
+		static constexpr int MANY_LIGHTS_SAMPLE_COUNT{ 2 };
+		static constexpr int MAX_AREA_LIGHT_STRATA{ 16 };
+		static constexpr int MAX_BOUNCES{ 8 };
+		static constexpr int MAX_AMBIENT_OCCLUSION_STRATA{ 8 };
+		//Secondary rays carrying less than this share of the light are continued by Russian roulette
+		static constexpr float BOUNCE_MIN_THROUGHPUT{ 0.05f };
+		static constexpr float BOUNCE_RAY_OFFSET{ 0.0001f };
+		//Paths end here even when Russian roulette keeps them going
+		static constexpr int MAX_PATH_LENGTH{ 16 };
+		//Bounces before Russian roulette starts ending paths by their throughput
+		static constexpr int PATH_ROULETTE_DEPTH{ 3 };
+		//Shadow rays traced per work item in wavefront mode
+		static constexpr uint32_t SHADOW_RAY_BATCH_SIZE{ 1024 };
+		//Every pixel is shaded from scratch at least once per this many frames
+		static constexpr uint32_t TEMPORAL_REFRESH_INTERVAL{ 16 };
+		//Reprojected samples further apart than this fraction of their distance to the camera are a different surface
+		static constexpr float TEMPORAL_MAX_DISTANCE_RATIO{ 0.01f };
+		static constexpr float TEMPORAL_MIN_NORMAL_COS{ 0.95f };
+		//Tiles that miss the deadline while the view changed are traced once per square of this many pixels
+		static constexpr int COARSE_BLOCK_SIZE{ 4 };
+		//Share of the frame budget the coarse fill may run past the deadline, tiles it does not reach keep last frame's pixels
+		static constexpr float COARSE_BUDGET_FRACTION{ 0.25f };
+		//Identical frames rendered before heap allocations count as a bug
+		static constexpr uint32_t ALLOCATION_WARMUP_FRAMES{ 4 };
+
+		//Unshadowed contribution of one light waiting for its shadow ray
+		struct ShadowCandidate
+		{
+			ColorRGB color{};
+			float luminance{};
+			uint32_t lightIndex{};
+			Ray shadowRay{};
+		};
+
+		//Shadow ray queued by the wavefront primary pass, added to its pixel once traced
+		struct ShadowRayRecord
+		{
+			Ray shadowRay{};
+			ColorRGB color{};
+			uint32_t pixelIndex{};
+			uint32_t lightIndex{};
+			bool isTraced{}; //False for the lights below the shadow cutoff, those count as lit
+			bool isVisible{};
+		};
+
+		//Surface and shading of one pixel, kept for the next frame
+		struct TemporalSample
+		{
+			Vector3 position{};
+			Vector3 normal{};
+			ColorRGB color{};
+			MaterialId materialIndex{};
+			bool didHit{};
+		};
+
+		//Everything besides the camera that changes the shading of a surface
+		struct TemporalState
+		{
+			uint32_t geometryVersion{};
+			LightingMode lightMode{};
+			bool shadowsEnabled{};
+			bool lightClusters{};
+			uint8_t bounceLimit{};
+
+			bool operator==(const TemporalState& other) const = default;
+		};
+
+		//Everything besides geometry that invalidates the previous image for partial redraws
+		struct RedrawState
+		{
+			Matrix cameraToWorld{};
+			float fovFactor{};
+			LightingMode lightMode{};
+			bool shadowsEnabled{};
+			bool lightCulling{};
+			float shadowCutoff{};
+			uint8_t bounceLimit{};
+			//Progressive frames accumulate over the whole image and leave no stale tiles behind
+			bool isProgressive{};
+
+			bool operator==(const RedrawState& other) const = default;
+		};
+
+		struct WorldBounds
+		{
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+		};
+
+		//Everything that invalidates the accumulated image when it changes
+		struct AccumulationState
+		{
+			Matrix cameraToWorld{};
+			float fovFactor{};
+			uint32_t geometryVersion{};
+			LightingMode lightMode{};
+			bool shadowsEnabled{};
+			SamplerType samplerType{};
+			uint8_t areaLightStrata{};
+			uint8_t bounceLimit{};
+
+			bool operator==(const AccumulationState& other) const = default;
+		};
 
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
-		std::vector<uint32_t> m_ImageHorizontalIterator, m_ImageVerticalIterator;
+		std::vector<uint32_t> m_ImageVerticalIterator;
 		//std::vector<uint32_t> m_PixelIndexes;
 		int m_Width{};
 		int m_Height{};
 		float m_AspectRatio{};
 		int m_AmountOfPixels{};
+
+		//Pixels are rendered in square tiles, the tiles and the pixels inside them follow a Z-order curve
+		//so rays traced one after another hit the same BVH nodes and mesh data
+		int m_TilesX{};
+		std::vector<uint32_t> m_TileOrder{};
+		std::vector<uint16_t> m_TilePixelOrder{}; //x | y << 8 inside the tile
+
+		LightTree m_LightTree{};
+		const Light* m_pLightSource{};
+		size_t m_LightSourceCount{};
+		size_t m_BoundedLightCount{};
+		//Their shadow rays are not queued in wavefront mode
+		size_t m_AreaLightCount{};
+		std::vector<uint32_t> m_AllLightIndices{};
+
+		//Every thread adds the secondary rays of its pixels, read and reset once per frame
+		mutable std::atomic<uint64_t> m_SecondaryRayCount{};
+		//Sample of the pixel sequences that RenderTiles renders
+		uint32_t m_RequestSampleIndex{};
+		uint64_t m_LastSecondaryRayCount{};
+		//Whether the last frame shaded every pixel itself, only then its secondary rays are the cost of the depth
+		bool m_WasShadedFully{};
+
+		LightClusterGrid m_LightClusters{};
+		//Primary hit of every pixel, kept across frames for the tiles that are not retraced
+		std::vector<HitRecord> m_PrimaryHits{};
+
+		//Normalized primary ray directions, one array per component so regenerating them vectorizes.
+		//Only rebuilt when the camera turns or the fov changes
+		std::vector<float> m_RayDirectionsX{}, m_RayDirectionsY{}, m_RayDirectionsZ{};
+		Vector3 m_RayDirectionsForward{};
+		float m_RayDirectionsFov{};
+		bool m_RayDirectionsValid{};
+		bool m_UseLightClusters{};
+
+		//Wavefront mode, one queue per tile so the primary pass can fill them without locking
+		std::vector<std::vector<ShadowRayRecord>> m_TileShadowRays{};
+		std::vector<uint32_t> m_ShadowRayBuckets{};
+		std::vector<ShadowRayRecord*> m_ShadowRayOrder{};
+		std::vector<uint32_t> m_ShadowRayBatches{};
+		std::vector<ColorRGB> m_WavefrontColors{};
+
+		std::vector<TemporalSample> m_TemporalSamples{}, m_PreviousTemporalSamples{};
+		Matrix m_PreviousWorldToCamera{};
+		float m_PreviousFovFactor{};
+		TemporalState m_TemporalState{};
+		bool m_HasTemporalHistory{};
+
+		//Partial redraws, bounds of every mesh as last rendered and the union of old and new bounds of the ones that moved
+		const TriangleMesh* m_pMeshSource{};
+		std::vector<WorldBounds> m_MeshBounds{};
+		std::vector<uint32_t> m_MeshVersions{};
+		std::vector<WorldBounds> m_ChangedBounds{};
+		std::vector<uint8_t> m_IsTileChanged{};
+		std::vector<uint32_t> m_ChangedTileOrder{};
+		RedrawState m_RedrawState{};
+		bool m_HasRedrawHistory{};
+
+		//Deadline mode, tiles in the order they get traced and the ones whose pixels are not from a full trace of the current view
+		std::vector<uint32_t> m_DeadlineTileOrder{};
+		std::vector<uint8_t> m_IsTileStale{};
+		std::vector<uint32_t> m_TileAges{}; //Frames since the tile was last traced or coarse filled
+		std::vector<uint32_t> m_StaleTiles{};
+		std::vector<uint32_t> m_DeadlineWorkers{};
+		//Measured time to render one tile and to coarse fill one, decides whether a tile still fits before the deadline
+		float m_TileSeconds{};
+		float m_CoarseTileSeconds{};
+
+		std::vector<ColorRGB> m_AccumulationBuffer{};
+		//Samples of the tiles of a distributed progressive frame, before they are accumulated
+		std::vector<ColorRGB> m_TileSamples{};
+		AccumulationState m_AccumulationState{};
+		uint32_t m_AccumulatedFrames{};
+		uint32_t m_FrameIndex{};
+
+#if defined(TRACK_HEAP_ALLOCATIONS)
+		AccumulationState m_AllocationCheckState{};
+		bool m_AllocationCheckManyLights{};
+		bool m_AllocationCheckLightCulling{};
+		uint32_t m_UnchangedFrames{};
+
+		void CheckHeapAllocations(const AccumulationState& state, size_t allocationCount);
+#endif
+
+		//Renders requestedTiles, or the whole frame when it is empty
+		void RenderFrame(Scene* pScene, std::span<const uint32_t> requestedTiles);
+
+		template<typename TileFunction>
+		void ForEachTile(const TileFunction& tileFunction) const;
+		template<typename PixelFunction>
+		void ForEachPixelInTile(uint32_t tileIndex, const PixelFunction& pixelFunction) const;
+		//Calls pixelFunction(pixelIndex) for every pixel of tiles, tiles in parallel
+		template<typename PixelFunction>
+		void ForEachPixel(std::span<const uint32_t> tiles, const PixelFunction& pixelFunction) const;
+		//Calls tileFunction(tileIndex) on all threads with the tiles started strictly in order, stops once the next tile
+		//is expected to end after the deadline. tileSeconds is the expected time per tile and gets updated with the measured one
+		template<typename TileFunction>
+		void ForEachTileUntil(std::span<const uint32_t> tiles, std::chrono::steady_clock::time_point deadline, float& tileSeconds,
+			const TileFunction& tileFunction);
+		//Traces one pixel per COARSE_BLOCK_SIZE square and copies it over the square. hitFunction fills the primary hit of a pixel
+		template<typename HitFunction, typename PixelFunction>
+		void FillTileCoarse(uint32_t tileIndex, const HitFunction& hitFunction, const PixelFunction& pixelFunction, const std::vector<Light>& lights);
+		//Puts the stale ones of tiles into m_DeadlineTileOrder, from the centre of the image out
+		void SortTilesByPriority(std::span<const uint32_t> tiles);
+
+		//Records the meshes that moved since the last frame, false if the set of meshes itself changed
+		bool UpdateMeshBounds(const Scene* pScene);
+		//Fills m_ChangedTileOrder with the tiles whose pixels can differ from the previous frame
+		void FindChangedTiles(const Scene* pScene, const Matrix& cameraToWorld, float fovFactor);
+		void MarkProjectedBounds(const WorldBounds& bounds, const Matrix& worldToCamera, float fovFactor);
+		bool IsShadowedByChangedMesh(const Scene* pScene, const HitRecord& hit) const;
+
+		//Looks up the surface seen through pixelIndex in last frame's samples, false if it has to be shaded again
+		bool TryReuseShading(const HitRecord& hit, uint32_t pixelIndex, ColorRGB& color) const;
+		void RenderWavefront(const Scene* pScene, const Vector3& cameraOrigin);
+		void QueueShadowRays(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t pixelIndex,
+			std::span<const uint32_t> lightIndices, std::vector<ShadowRayRecord>& queue) const;
+		static uint32_t GetShadowRayBucket(const ShadowRayRecord& record);
+		void WritePixel(uint32_t pixelIndex, ColorRGB finalColor) const;
+
+		void UpdateLights(const std::vector<Light>& lights);
+		void UpdateAccumulation(const AccumulationState& state);
+
+		void UpdateRayDirections(const Matrix& cameraToWorld, float fovFactor);
+		Vector3 GetRayDirection(uint32_t pixelIndex) const
+		{
+			return { m_RayDirectionsX[pixelIndex], m_RayDirectionsY[pixelIndex], m_RayDirectionsZ[pixelIndex] };
+		}
+		//Direction through a point of the pixel instead of its centre, offsets in [0, 1) from the top left corner
+		Vector3 GetRayDirection(uint32_t pixelIndex, float offsetX, float offsetY, const Matrix& cameraToWorld, float fovFactor) const;
+		ColorRGB EvaluateLight(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Light& light, Ray& shadowRay) const;
+		//Light arriving from lightDirection with the given radiance, shaded in the current lighting mode
+		ColorRGB EvaluateLightDirection(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Vector3& lightDirection,
+			const ColorRGB& radiance) const;
+		//Stratified estimate over the surface of an area light. The shadow rays of one sample per quadrant decide: when they
+		//are all lit the other strata are shaded without shadow rays, when they are all shadowed the light is skipped
+		ColorRGB ShadeAreaLight(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t lightIndex,
+			const Sampler& sampler, bool testVisibility) const;
+		ColorRGB ShadeLight(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t lightIndex, const Sampler& sampler) const;
+		//Last shadow ray occluder per light for the calling thread
+		Occluder* GetOccluderCache() const;
+		//Lights of lightIndices that can contribute, evaluated unshadowed and in tracing order. Stored in arena
+		std::span<ShadowCandidate> GatherShadowCandidates(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection,
+			std::span<const uint32_t> lightIndices, FrameArena& arena, float& totalLuminance) const;
+		ColorRGB ShadeLights(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, std::span<const uint32_t> lightIndices,
+			const Sampler& sampler) const;
+		//Direct light of a hit from every light, or from the light tree in many lights mode
+		ColorRGB ShadeDirect(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const;
+		//Light reaching a hit along its reflection and refraction rays, up to m_BounceLimit levels deep
+		ColorRGB TraceBounces(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const;
+		void UpdateBounceLimit();
+		//Secondary rays and ambient light of the combined mode, added on top of the direct light
+		ColorRGB ShadeIndirect(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const;
+		//Share of cosine weighted rays from the hit that travel m_AmbientOcclusionRadius without being blocked
+		float GetAmbientOcclusion(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const;
+		//Direct light at every vertex of a path leaving the hit by importance sampled bounces, the primary hit included
+		ColorRGB TracePath(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, const Sampler& sampler) const;
+		ColorRGB ShadeHit(const Scene* pScene, const HitRecord& hit, const Vector3& rayDirection, uint32_t pixelIndex, const Sampler& sampler) const;
 	};
 }
@@ -0,0 +1,230 @@
+#include "Sampler.h"
+#include "MathHelpers.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		//Direction numbers of the second Sobol dimension (primitive polynomial x + 1), the first one is the bit reversed index
+		constexpr std::array<uint32_t, 32> SOBOL_DIRECTIONS{ []
+			{
+				std::array<uint32_t, 32> directions{};
+				directions[0] = 1u << 31;
+				for (size_t bit = 1; bit < directions.size(); ++bit)
+					directions[bit] = directions[bit - 1] ^ (directions[bit - 1] >> 1);
+				return directions;
+			}() };
+
+		//Blue noise mask, a power of two so wrapping around is a mask
+		constexpr int BLUE_NOISE_SIZE{ 64 };
+		constexpr int BLUE_NOISE_PIXEL_COUNT{ BLUE_NOISE_SIZE * BLUE_NOISE_SIZE };
+		//Width of the energy filter of void and cluster, 1.5 is the value from Ulichney's paper
+		constexpr float BLUE_NOISE_SIGMA{ 1.5f };
+		//Steps of the R2 sequence (Roberts 2018) as fractions of 2^32, 1 / g and 1 / g^2 with g the plastic number.
+		//Pairs of dimensions advance by both, which keeps the 2D points of a pixel off a line
+		constexpr uint32_t R2_STEPS[2]{ 0xC13FA9A9u, 0x91E10DA6u };
+
+		uint32_t ReverseBits(uint32_t value)
+		{
+			value = (value << 16) | (value >> 16);
+			value = ((value & 0x00FF00FFu) << 8) | ((value & 0xFF00FF00u) >> 8);
+			value = ((value & 0x0F0F0F0Fu) << 4) | ((value & 0xF0F0F0F0u) >> 4);
+			value = ((value & 0x33333333u) << 2) | ((value & 0xCCCCCCCCu) >> 2);
+			value = ((value & 0x55555555u) << 1) | ((value & 0xAAAAAAAAu) >> 1);
+			return value;
+		}
+
+		//Owen scrambling as a hash (Burley 2020, Practical Hash-based Owen Scrambling). Every bit is flipped depending
+		//on the bits above it, points of a stratified set stay stratified
+		uint32_t NestedUniformScramble(uint32_t value, uint32_t seed)
+		{
+			value = ReverseBits(value);
+			value ^= value * 0x3D20ADEAu;
+			value += seed;
+			value *= (seed >> 16) | 1u;
+			value ^= value * 0x05526C56u;
+			value ^= value * 0x53A22864u;
+			return ReverseBits(value);
+		}
+
+		float ToUnitFloat(uint32_t bits)
+		{
+			return (bits >> 8) * (1.f / 16777216.f);
+		}
+
+		//Rank of every pixel of a tileable blue noise mask, built with void and cluster (Ulichney 1993)
+		std::array<uint16_t, BLUE_NOISE_PIXEL_COUNT> BuildBlueNoiseMask()
+		{
+			constexpr int wrap{ BLUE_NOISE_SIZE - 1 };
+			std::vector<float> kernel(BLUE_NOISE_PIXEL_COUNT);
+			for (int y = 0; y < BLUE_NOISE_SIZE; ++y)
+			{
+				for (int x = 0; x < BLUE_NOISE_SIZE; ++x)
+				{
+					const int dx{ std::min(x, BLUE_NOISE_SIZE - x) }, dy{ std::min(y, BLUE_NOISE_SIZE - y) };
+					kernel[x + y * BLUE_NOISE_SIZE] = expf(-float(dx * dx + dy * dy) / (2.f * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+				}
+			}
+
+			//Energy is how crowded the neighbourhood of a pixel is with set pixels
+			std::vector<float> energy(BLUE_NOISE_PIXEL_COUNT);
+			std::vector<uint8_t> isSet(BLUE_NOISE_PIXEL_COUNT);
+			const auto setPixel{ [&](int pixel, bool set)
+				{
+					isSet[pixel] = set;
+					const float sign{ set ? 1.f : -1.f };
+					const int px{ pixel % BLUE_NOISE_SIZE }, py{ pixel / BLUE_NOISE_SIZE };
+					for (int y = 0; y < BLUE_NOISE_SIZE; ++y)
+					{
+						for (int x = 0; x < BLUE_NOISE_SIZE; ++x)
+							energy[x + y * BLUE_NOISE_SIZE] += sign * kernel[((x - px) & wrap) + ((y - py) & wrap) * BLUE_NOISE_SIZE];
+					}
+				} };
+			const auto findTightestCluster{ [&]
+				{
+					int found{ -1 };
+					for (int pixel = 0; pixel < BLUE_NOISE_PIXEL_COUNT; ++pixel)
+					{
+						if (isSet[pixel] && (found < 0 || energy[pixel] > energy[found]))
+							found = pixel;
+					}
+					return found;
+				} };
+			const auto findLargestVoid{ [&]
+				{
+					int found{ -1 };
+					for (int pixel = 0; pixel < BLUE_NOISE_PIXEL_COUNT; ++pixel)
+					{
+						if (!isSet[pixel] && (found < 0 || energy[pixel] < energy[found]))
+							found = pixel;
+					}
+					return found;
+				} };
+
+			//Random initial pattern, relaxed by moving its tightest cluster into its largest void until that changes nothing
+			constexpr int initialCount{ BLUE_NOISE_PIXEL_COUNT / 10 };
+			uint32_t randomState{ 1 };
+			for (int placed = 0; placed < initialCount;)
+			{
+				randomState = HashPCG(randomState);
+				const int pixel{ int(randomState % BLUE_NOISE_PIXEL_COUNT) };
+				if (isSet[pixel]) continue;
+				setPixel(pixel, true);
+				++placed;
+			}
+			for (int iteration = 0; iteration < BLUE_NOISE_PIXEL_COUNT; ++iteration)
+			{
+				const int cluster{ findTightestCluster() };
+				setPixel(cluster, false);
+				const int largestVoid{ findLargestVoid() };
+				setPixel(largestVoid, true);
+				if (largestVoid == cluster) break;
+			}
+
+			//The pattern's pixels are ranked by taking them out tightest cluster first, the other pixels by filling the
+			//largest void. Past half the voids of the set pixels are the clusters of the unset ones, one loop covers both
+			std::array<uint16_t, BLUE_NOISE_PIXEL_COUNT> ranks{};
+			const std::vector<float> initialEnergy{ energy };
+			const std::vector<uint8_t> initialIsSet{ isSet };
+			for (int rank = initialCount - 1; rank >= 0; --rank)
+			{
+				const int cluster{ findTightestCluster() };
+				setPixel(cluster, false);
+				ranks[cluster] = uint16_t(rank);
+			}
+			energy = initialEnergy;
+			isSet = initialIsSet;
+			for (int rank = initialCount; rank < BLUE_NOISE_PIXEL_COUNT; ++rank)
+			{
+				const int largestVoid{ findLargestVoid() };
+				setPixel(largestVoid, true);
+				ranks[largestVoid] = uint16_t(rank);
+			}
+			return ranks;
+		}
+	}
+
+	Sampler::Sampler(SamplerType type, uint32_t pixelX, uint32_t pixelY, uint32_t frameIndex) :
+		m_Type{ type },
+		m_PixelX{ pixelX },
+		m_PixelY{ pixelY },
+		m_PixelSeed{ HashPCG(pixelX ^ HashPCG(pixelY)) },
+		m_FrameIndex{ frameIndex }
+	{
+	}
+
+	float Sampler::Get(SampleDimension dimension, uint32_t sample, uint32_t samplesPerFrame) const
+	{
+		const uint32_t sampleIndex{ m_FrameIndex * samplesPerFrame + sample };
+		const uint32_t index{ m_DimensionOffset + uint32_t(dimension) };
+		switch (m_Type)
+		{
+		case SamplerType::Sobol:
+			return GetSobol(sampleIndex, index);
+		case SamplerType::BlueNoise:
+			return GetBlueNoise(sampleIndex, index);
+		default:
+			return ToUnitFloat(HashPCG(m_PixelSeed ^ HashPCG(sampleIndex ^ HashPCG(index))));
+		}
+	}
+
+	Sampler Sampler::ForVertex(uint32_t vertexIndex) const
+	{
+		//An even stride keeps the dimension pairs that are stratified together
+		static_assert(uint32_t(SampleDimension::Count) % 2 == 0);
+		Sampler vertexSampler{ *this };
+		vertexSampler.m_DimensionOffset = m_DimensionOffset + vertexIndex * uint32_t(SampleDimension::Count);
+		return vertexSampler;
+	}
+
+	const char* Sampler::GetName(SamplerType type)
+	{
+		switch (type)
+		{
+		case SamplerType::Sobol: return "Sobol";
+		case SamplerType::BlueNoise: return "blue noise";
+		default: return "white noise";
+		}
+	}
+
+	float Sampler::GetSobol(uint32_t sampleIndex, uint32_t dimension) const
+	{
+		//Only the first two Sobol dimensions are used, they form a (0, 2) sequence. Every pair of dimensions
+		//shuffles the sample order with its own seed, which decorrelates it from the other pairs
+		const uint32_t pairSeed{ HashPCG(m_PixelSeed ^ HashPCG(dimension / 2)) };
+		const uint32_t index{ NestedUniformScramble(sampleIndex, pairSeed) };
+
+		uint32_t bits{};
+		if (dimension % 2 == 0)
+			bits = ReverseBits(index);
+		else
+		{
+			for (uint32_t bit = 0, remaining = index; remaining != 0; remaining >>= 1, ++bit)
+			{
+				if (remaining & 1)
+					bits ^= SOBOL_DIRECTIONS[bit];
+			}
+		}
+		return ToUnitFloat(NestedUniformScramble(bits, HashPCG(pairSeed + dimension)));
+	}
+
+	float Sampler::GetBlueNoise(uint32_t sampleIndex, uint32_t dimension) const
+	{
+		static const std::array<uint16_t, BLUE_NOISE_PIXEL_COUNT> mask{ BuildBlueNoiseMask() };
+
+		//Every dimension reads the mask at another offset, neighbouring pixels still get values far apart
+		const uint32_t offset{ HashPCG(dimension + 1) };
+		const uint32_t x{ (m_PixelX + offset) % BLUE_NOISE_SIZE };
+		const uint32_t y{ (m_PixelY + (offset >> 16)) % BLUE_NOISE_SIZE };
+		const uint32_t rank{ mask[x + y * BLUE_NOISE_SIZE] };
+
+		//Centre of the rank's interval as a fraction of 2^32, wrapping around is taking the fractional part
+		const uint32_t bits{ (rank << 20) + (1u << 19) + sampleIndex * R2_STEPS[dimension % 2] };
+		return ToUnitFloat(bits);
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	enum class SamplerType : uint8_t
+	{
+		WhiteNoise, //Hashed, independent per pixel and sample
+		Sobol, //Owen scrambled Sobol points, every pixel gets its own scramble
+		BlueNoise, //Tiled blue noise mask, shifted along the R2 sequence every sample
+		Count
+	};
+
+	//Every random decision of a pixel sample reads its own dimension so they do not correlate.
+	//Dimensions 2n and 2n + 1 are stratified together as a 2D point when they are read with the same sample
+	enum class SampleDimension : uint32_t
+	{
+		PixelX,
+		PixelY,
+		AreaLightU,
+		AreaLightV,
+		BounceU,
+		BounceV,
+		LightSelection,
+		PathLobe,
+		AmbientOcclusionU,
+		AmbientOcclusionV,
+		Count
+	};
+
+	//Deterministic random numbers of one pixel. Consecutive sample indices of a pixel are well spread over [0, 1)
+	//so an average over them converges faster than over independent random numbers
+	class Sampler final
+	{
+	public:
+		//frameIndex counts the frames this pixel was sampled in before, 0 after the accumulation restarted
+		Sampler(SamplerType type, uint32_t pixelX, uint32_t pixelY, uint32_t frameIndex);
+
+		//Value in [0, 1) of dimension for the sample-th of the samplesPerFrame samples the pixel takes of it this frame
+		float Get(SampleDimension dimension, uint32_t sample = 0, uint32_t samplesPerFrame = 1) const;
+		//Same pixel and frame, but every dimension reads values of its own for the vertexIndex-th vertex of a path, 0 is this sampler
+		Sampler ForVertex(uint32_t vertexIndex) const;
+
+		static const char* GetName(SamplerType type);
+
+	private:
+		SamplerType m_Type;
+		uint32_t m_PixelX;
+		uint32_t m_PixelY;
+		uint32_t m_PixelSeed;
+		uint32_t m_FrameIndex;
+		uint32_t m_DimensionOffset{};
+
+		float GetSobol(uint32_t sampleIndex, uint32_t dimension) const;
+		float GetBlueNoise(uint32_t sampleIndex, uint32_t dimension) const;
+	};
+}
@@ -1,14 +1,22 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "MappedFile.h"
+#include "FrameArena.h"
+#include "TextParsing.h"
 #include "iostream"
+#include <algorithm>
+#include <limits>
+#include <filesystem>
+#include <map>
+#include <random>
 
 namespace dae {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene() :
-		m_Materials({ new Material_SolidColor({1,0,0}) })
+		m_Materials({ Material::CreateSolidColor({1,0,0}) })
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
@@ -16,16 +24,7 @@ namespace dae {
 		m_Lights.reserve(32);
 	}
 
-	Scene::~Scene()
-	{
-		for (auto& pMaterial : m_Materials)
-		{
-			delete pMaterial;
-			pMaterial = nullptr;
-		}
-
-		m_Materials.clear();
-	}
+	Scene::~Scene() = default;
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
@@ -55,25 +54,154 @@ namespace dae {
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		//todo W3
-		//assert(false && "No Implemented Yet!");
+		Occluder occluder{};
+		return DoesHit(ray, occluder);
+	}
+
+	bool Scene::DoesHit(const Ray& ray, Occluder& lastOccluder) const
+	{
+		//Neighbouring shadow rays towards the same light are usually blocked by the same primitive
+		if (IsOccludedBy(ray, lastOccluder)) return true;
+
+		//Analytic primitives first, meshes last
 		for (const Sphere& sphere : m_SphereGeometries)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphere, ray)) return true;
+			if (!GeometryUtils::HitTest_Sphere(sphere, ray)) continue;
+			lastOccluder = { Occluder::Type::Sphere, static_cast<uint32_t>(&sphere - m_SphereGeometries.data()) };
+			return true;
 		}
 		for (const Plane& plane : m_PlaneGeometries)
 		{
-			if (GeometryUtils::HitTest_Plane(plane, ray)) return true;
+			if (!GeometryUtils::HitTest_Plane(plane, ray)) continue;
+			lastOccluder = { Occluder::Type::Plane, static_cast<uint32_t>(&plane - m_PlaneGeometries.data()) };
+			return true;
 		}
 		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
 		{
-			if (GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray)) return true;
+			uint32_t triangleIndex{};
+			if (!GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, triangleIndex)) continue;
+			lastOccluder = { Occluder::Type::MeshTriangle, static_cast<uint32_t>(&triangleMesh - m_TriangleMeshGeometries.data()), triangleIndex };
+			return true;
 		}
+
+		//Lit rays tend to be followed by more lit rays, forget the occluder so they skip the extra test
+		lastOccluder.type = Occluder::Type::None;
 		return false;
 	}
 
+	uint32_t Scene::CountOccludedRays(const Vector3& origin, std::span<const Vector3> directions, float maxDistance) const
+	{
+		FrameArena& arena{ FrameArena::Get() };
+		const FrameArena::Scope arenaScope{ arena };
+
+		//Indices of the primitives the rays can reach, by distance to the sphere, plane or bounding box
+		uint32_t* const pSpheres{ arena.Allocate<uint32_t>(m_SphereGeometries.size()) };
+		uint32_t sphereCount{};
+		for (uint32_t index = 0; index < static_cast<uint32_t>(m_SphereGeometries.size()); ++index)
+		{
+			const Sphere& sphere{ m_SphereGeometries[index] };
+			if ((sphere.origin - origin).SqrMagnitude() <= Square(sphere.radius + maxDistance))
+				pSpheres[sphereCount++] = index;
+		}
+		uint32_t* const pPlanes{ arena.Allocate<uint32_t>(m_PlaneGeometries.size()) };
+		uint32_t planeCount{};
+		for (uint32_t index = 0; index < static_cast<uint32_t>(m_PlaneGeometries.size()); ++index)
+		{
+			const Plane& plane{ m_PlaneGeometries[index] };
+			if (fabsf(Vector3::Dot(origin - plane.origin, plane.normal)) <= maxDistance)
+				pPlanes[planeCount++] = index;
+		}
+		uint32_t* const pMeshes{ arena.Allocate<uint32_t>(m_TriangleMeshGeometries.size()) };
+		uint32_t meshCount{};
+		for (uint32_t index = 0; index < static_cast<uint32_t>(m_TriangleMeshGeometries.size()); ++index)
+		{
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[index] };
+			const Vector3 closest{ Vector3::Max(mesh.transformedMinAABB, Vector3::Min(origin, mesh.transformedMaxAABB)) };
+			if ((closest - origin).SqrMagnitude() <= Square(maxDistance))
+				pMeshes[meshCount++] = index;
+		}
+
+		uint32_t occludedCount{};
+		Occluder lastOccluder{};
+		for (const Vector3& direction : directions)
+		{
+			const Ray ray{ origin, direction, 0.0001f, maxDistance };
+			//Rays next to each other are often blocked by the same primitive
+			if (IsOccludedBy(ray, lastOccluder))
+			{
+				++occludedCount;
+				continue;
+			}
+
+			bool isOccluded{};
+			for (uint32_t i = 0; i < sphereCount && !isOccluded; ++i)
+			{
+				if (!GeometryUtils::HitTest_Sphere(m_SphereGeometries[pSpheres[i]], ray)) continue;
+				lastOccluder = { Occluder::Type::Sphere, pSpheres[i] };
+				isOccluded = true;
+			}
+			for (uint32_t i = 0; i < planeCount && !isOccluded; ++i)
+			{
+				if (!GeometryUtils::HitTest_Plane(m_PlaneGeometries[pPlanes[i]], ray)) continue;
+				lastOccluder = { Occluder::Type::Plane, pPlanes[i] };
+				isOccluded = true;
+			}
+			for (uint32_t i = 0; i < meshCount && !isOccluded; ++i)
+			{
+				uint32_t triangleIndex{};
+				if (!GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[pMeshes[i]], ray, triangleIndex)) continue;
+				lastOccluder = { Occluder::Type::MeshTriangle, pMeshes[i], triangleIndex };
+				isOccluded = true;
+			}
+			if (isOccluded) ++occludedCount;
+		}
+		return occludedCount;
+	}
+
+	bool Scene::IsOccludedBy(const Ray& ray, const Occluder& occluder) const
+	{
+		//The cache can outlive geometry changes, validate the indices before using them
+		switch (occluder.type)
+		{
+		case Occluder::Type::Plane:
+			return occluder.primitiveIndex < m_PlaneGeometries.size() &&
+				GeometryUtils::HitTest_Plane(m_PlaneGeometries[occluder.primitiveIndex], ray);
+		case Occluder::Type::Sphere:
+			return occluder.primitiveIndex < m_SphereGeometries.size() &&
+				GeometryUtils::HitTest_Sphere(m_SphereGeometries[occluder.primitiveIndex], ray);
+		case Occluder::Type::MeshTriangle:
+		{
+			if (occluder.primitiveIndex >= m_TriangleMeshGeometries.size()) return false;
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[occluder.primitiveIndex] };
+			return occluder.triangleIndex + 2 < mesh.indices.size() &&
+				GeometryUtils::HitTest_MeshTriangle(mesh, occluder.triangleIndex, ray);
+		}
+		default:
+			return false;
+		}
+	}
+
+	uint32_t Scene::GetGeometryVersion() const
+	{
+		uint32_t version{ 0 };
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			version += triangleMesh.transformVersion;
+		}
+		return version;
+	}
+
+	void Scene::SetLightCutoff(float threshold)
+	{
+		for (Light& light : m_Lights)
+		{
+			if (light.type != LightType::Point) continue;
+			light.influenceRadius = (threshold > 0.f) ? LightUtils::GetInfluenceRadius(light, threshold) : 0.f;
+		}
+	}
+
 #pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	Sphere* Scene::AddSphere(const Vector3& origin, float radius, MaterialId materialIndex)
 	{
 		Sphere s;
 		s.origin = origin;
@@ -84,7 +212,7 @@ namespace dae {
 		return &m_SphereGeometries.back();
 	}
 
-	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
+	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, MaterialId materialIndex)
 	{
 		Plane p;
 		p.origin = origin;
@@ -95,7 +223,7 @@ namespace dae {
 		return &m_PlaneGeometries.back();
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, MaterialId materialIndex)
 	{
 		TriangleMesh m{};
 		m.cullMode = cullMode;
@@ -129,10 +257,39 @@ namespace dae {
 		return &m_Lights.back();
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
+	Light* Scene::AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.radius = radius;
+		l.intensity = intensity;
+		l.color = color;
+		l.type = LightType::Sphere;
+
+		m_Lights.emplace_back(l);
+		return &m_Lights.back();
+	}
+
+	Light* Scene::AddQuadLight(const Vector3& origin, const Vector3& edgeX, const Vector3& edgeY, float intensity, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.edgeX = edgeX;
+		l.edgeY = Vector3::Reject(edgeY, edgeX);
+		l.direction = Vector3::Cross(l.edgeX, l.edgeY).Normalized();
+		l.intensity = intensity;
+		l.color = color;
+		l.type = LightType::Quad;
+
+		m_Lights.emplace_back(l);
+		return &m_Lights.back();
+	}
+
+	MaterialId Scene::AddMaterial(const Material& material)
 	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
+		assert(m_Materials.size() <= std::numeric_limits<MaterialId>::max() && "Material pool is full");
+		m_Materials.push_back(material);
+		return static_cast<MaterialId>(m_Materials.size() - 1);
 	}
 #pragma endregion
 #pragma endregion
@@ -141,12 +298,12 @@ namespace dae {
 	void Scene_W1::Initialize()
 	{
 		//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		constexpr MaterialId matId_Solid_Red = 0;
+		const MaterialId matId_Solid_Blue = AddMaterial(Material::CreateSolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const MaterialId matId_Solid_Yellow = AddMaterial(Material::CreateSolidColor(colors::Yellow));
+		const MaterialId matId_Solid_Green = AddMaterial(Material::CreateSolidColor(colors::Green));
+		const MaterialId matId_Solid_Magenta = AddMaterial(Material::CreateSolidColor(colors::Magenta));
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -177,12 +334,12 @@ namespace dae {
 		//m_Camera.UpdateFOV(45.f);
 
 		//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		constexpr MaterialId matId_Solid_Red = 0;
+		const MaterialId matId_Solid_Blue = AddMaterial(Material::CreateSolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const MaterialId matId_Solid_Yellow = AddMaterial(Material::CreateSolidColor(colors::Yellow));
+		const MaterialId matId_Solid_Green = AddMaterial(Material::CreateSolidColor(colors::Green));
+		const MaterialId matId_Solid_Magenta = AddMaterial(Material::CreateSolidColor(colors::Magenta));
 
 		//planes
 		AddPlane({ -5.f,0.f,0.f }, { 1.f,0.f,0.f }, matId_Solid_Green);
@@ -211,19 +368,19 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.UpdateFOV(45.f);
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CreateCookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CreateCookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CreateCookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CreateCookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CreateCookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CreateCookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::CreateLambert(colors::White, 1.f));
 
-		const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
-		const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
-		const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
+		const auto matLambertPhong1 = AddMaterial(Material::CreateLambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
+		const auto matLambertPhong2 = AddMaterial(Material::CreateLambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
+		const auto matLambertPhong3 = AddMaterial(Material::CreateLambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -257,14 +414,14 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.UpdateFOV(45.f);
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CreateCookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CreateCookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CreateCookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CreateCookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CreateCookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CreateCookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::CreateLambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -323,8 +480,8 @@ namespace dae {
 		m_Camera.origin = { 0.f,3.f,-9.f };
 		m_Camera.UpdateFOV(45.f);
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::CreateLambert(colors::White, 1.f));
 		//Planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -333,12 +490,9 @@ namespace dae {
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
 		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny.obj",
-			pMesh->positions,
-			pMesh->indices);
+		Utils::LoadMesh("Resources/lowpoly_bunny.obj", *pMesh);
 
 		pMesh->Scale(Vector3{ 2,2,2 });
-		pMesh->UpdateAABB();
 		pMesh->UpdateTransforms();
 
 		//Light
@@ -365,8 +519,8 @@ namespace dae {
 		m_Camera.origin = { 0.f,3.f,-9.f };
 		m_Camera.UpdateFOV(45.f);
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_Orange = AddMaterial(new Material_Lambert(ColorRGB{0.7f,0.4f,0.f}, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_Orange = AddMaterial(Material::CreateLambert(ColorRGB{0.7f,0.4f,0.f}, 1.f));
 		//Planes 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -375,15 +529,12 @@ namespace dae {
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
 		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_Orange);
-		Utils::ParseOBJ("Resources/cat.obj",
-			pMesh->positions,
-			pMesh->indices);
+		Utils::LoadMesh("Resources/cat.obj", *pMesh);
 
 		//pMesh->Scale(Vector3{ 1.3f,1.3f,1.3f });
 		pMesh->Translate(Vector3{ 0,2,0 });
 		pMesh->RotateY(50.f * TO_RADIANS);
 
-		pMesh->UpdateAABB();
 		pMesh->UpdateTransforms();
 
 		//Light
@@ -417,5 +568,435 @@ namespace dae {
 	}
 #pragma endregion
 
-}
 
+#pragma region SCENE FILE
+	Scene_File::Scene_File(const std::string& filename) :
+		m_Filename(filename)
+	{
+	}
+
+	void Scene_File::Initialize()
+	{
+		sceneName = m_Filename;
+		m_IsLoaded = LoadFile();
+		if (!m_IsLoaded)
+			std::cout << "Scene file " << m_Filename << " could not be loaded completely\n";
+		m_AnimatedPoses.resize(m_MeshPoses.size());
+		m_IsMeshAnimated.resize(m_MeshPoses.size());
+	}
+
+	bool Scene_File::LoadFile()
+	{
+		using namespace TextParsing;
+
+		const MappedFile file{ m_Filename };
+		if (!file.IsOpen())
+		{
+			std::cout << m_Filename << ": cannot open file\n";
+			return false;
+		}
+
+		//Names are only stored for materials and meshes, primitives and lights are parsed without allocating
+		std::map<std::string, MaterialId, std::less<>> materialIds{ { "default", 0 } };
+		std::map<std::string, size_t, std::less<>> meshIndices{};
+		std::map<std::string, size_t, std::less<>> loadedMeshFiles{};
+
+		const char* pCurr{ file.GetData() };
+		const char* const pEnd{ pCurr + file.GetSize() };
+		int lineNumber{ 0 };
+
+		const auto reportError = [&](const char* message)
+		{
+			std::cout << m_Filename << "(" << lineNumber << "): " << message << "\n";
+			return false;
+		};
+		const auto parseFloats = [&](const char*& pLine, std::initializer_list<float*> values)
+		{
+			for (float* pValue : values)
+			{
+				if (!TryParseFloat(pLine, pEnd, *pValue)) return false;
+			}
+			return true;
+		};
+		const auto parseMaterial = [&](const char*& pLine, MaterialId& materialId)
+		{
+			std::string_view name{};
+			if (!TryParseToken(pLine, pEnd, name)) return false;
+			const auto it{ materialIds.find(name) };
+			if (it == materialIds.end()) return false;
+			materialId = it->second;
+			return true;
+		};
+
+		while (pCurr < pEnd)
+		{
+			++lineNumber;
+			const char* pLine{ pCurr };
+			pCurr = SkipLine(pCurr, pEnd);
+
+			std::string_view command{};
+			if (IsEndOfLine(pLine, pEnd) || !TryParseToken(pLine, pEnd, command))
+				continue;
+
+			if (command == "sphere")
+			{
+				Vector3 origin{};
+				float radius{};
+				MaterialId materialId{};
+				if (!parseFloats(pLine, { &origin.x, &origin.y, &origin.z, &radius }) || !parseMaterial(pLine, materialId))
+					return reportError("expected: sphere <x> <y> <z> <radius> <material>");
+				AddSphere(origin, radius, materialId);
+			}
+			else if (command == "plane")
+			{
+				Vector3 origin{}, normal{};
+				MaterialId materialId{};
+				if (!parseFloats(pLine, { &origin.x, &origin.y, &origin.z, &normal.x, &normal.y, &normal.z }) || !parseMaterial(pLine, materialId))
+					return reportError("expected: plane <x> <y> <z> <nx> <ny> <nz> <material>");
+				AddPlane(origin, normal.Normalized(), materialId);
+			}
+			else if (command == "pointlight" || command == "dirlight")
+			{
+				Vector3 vector{};
+				float intensity{};
+				ColorRGB color{};
+				if (!parseFloats(pLine, { &vector.x, &vector.y, &vector.z, &intensity, &color.r, &color.g, &color.b }))
+					return reportError("expected: pointlight|dirlight <x> <y> <z> <intensity> <r> <g> <b>");
+				if (command == "pointlight") AddPointLight(vector, intensity, color);
+				else AddDirectionalLight(vector.Normalized(), intensity, color);
+			}
+			else if (command == "spherelight")
+			{
+				Vector3 origin{};
+				float radius{}, intensity{};
+				ColorRGB color{};
+				if (!parseFloats(pLine, { &origin.x, &origin.y, &origin.z, &radius, &intensity, &color.r, &color.g, &color.b }) || radius <= 0.f)
+					return reportError("expected: spherelight <x> <y> <z> <radius> <intensity> <r> <g> <b>");
+				AddSphereLight(origin, radius, intensity, color);
+			}
+			else if (command == "quadlight")
+			{
+				Vector3 origin{}, edgeX{}, edgeY{};
+				float intensity{};
+				ColorRGB color{};
+				if (!parseFloats(pLine, { &origin.x, &origin.y, &origin.z, &edgeX.x, &edgeX.y, &edgeX.z, &edgeY.x, &edgeY.y, &edgeY.z,
+					&intensity, &color.r, &color.g, &color.b }) || Vector3::Cross(edgeX, edgeY).SqrMagnitude() <= 0.f)
+					return reportError("expected: quadlight <x> <y> <z> <ex> <ey> <ez> <fx> <fy> <fz> <intensity> <r> <g> <b>");
+				AddQuadLight(origin, edgeX, edgeY, intensity, color);
+			}
+			else if (command == "material")
+			{
+				std::string_view name{}, type{};
+				ColorRGB color{};
+				if (!TryParseToken(pLine, pEnd, name) || !TryParseToken(pLine, pEnd, type) || !parseFloats(pLine, { &color.r, &color.g, &color.b }))
+					return reportError("expected: material <name> <type> <r> <g> <b> ...");
+				if (m_Materials.size() > std::numeric_limits<MaterialId>::max())
+					return reportError("too many materials");
+
+				Material material{};
+				float params[3]{};
+				if (type == "solid")
+					material = Material::CreateSolidColor(color);
+				else if (type == "lambert" && parseFloats(pLine, { &params[0] }))
+					material = Material::CreateLambert(color, params[0]);
+				else if (type == "phong" && parseFloats(pLine, { &params[0], &params[1], &params[2] }))
+					material = Material::CreateLambertPhong(color, params[0], params[1], params[2]);
+				else if (type == "cooktorrence" && parseFloats(pLine, { &params[0], &params[1] }))
+					material = Material::CreateCookTorrence(color, params[0], params[1]);
+				else if (type == "dielectric" && parseFloats(pLine, { &params[0] }) && params[0] > 0.f)
+					material = Material::CreateDielectric(color, params[0]);
+				else
+					return reportError("expected: solid | lambert <kd> | phong <kd> <ks> <exponent> | cooktorrence <metalness> <roughness> | dielectric <ior>");
+
+				materialIds[std::string{ name }] = AddMaterial(material);
+			}
+			else if (command == "mesh")
+			{
+				std::string_view name{}, objFile{}, cullName{};
+				MaterialId materialId{};
+				if (!TryParseToken(pLine, pEnd, name) || !TryParseToken(pLine, pEnd, objFile) ||
+					!TryParseToken(pLine, pEnd, cullName) || !parseMaterial(pLine, materialId))
+					return reportError("expected: mesh <name> <file.obj> <back|front|none> <material> [translate x y z] [rotate pitch yaw roll] [scale x y z]");
+
+				TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+				if (cullName == "front") cullMode = TriangleCullMode::FrontFaceCulling;
+				else if (cullName == "none") cullMode = TriangleCullMode::NoCulling;
+				else if (cullName != "back") return reportError("cull mode must be back, front or none");
+
+				MeshPose pose{};
+				Vector3 scale{ 1.f, 1.f, 1.f };
+				std::string_view keyword{};
+				while (TryParseToken(pLine, pEnd, keyword))
+				{
+					Vector3* pTarget{ nullptr };
+					if (keyword == "translate") pTarget = &pose.translation;
+					else if (keyword == "rotate") pTarget = &pose.rotation;
+					else if (keyword == "scale") pTarget = &scale;
+					if (!pTarget || !parseFloats(pLine, { &pTarget->x, &pTarget->y, &pTarget->z }))
+						return reportError("expected: translate|rotate|scale <x> <y> <z>");
+				}
+				pose.rotation *= TO_RADIANS;
+
+				const size_t meshIndex{ m_TriangleMeshGeometries.size() };
+				TriangleMesh* pMesh{ AddTriangleMesh(cullMode, materialId) };
+
+				//Instances of the same file share one load
+				const auto loadedIt{ loadedMeshFiles.find(objFile) };
+				if (loadedIt != loadedMeshFiles.end())
+				{
+					const TriangleMesh& source{ m_TriangleMeshGeometries[loadedIt->second] };
+					pMesh->positions = source.positions;
+					pMesh->indices = source.indices;
+					pMesh->bvhNodes = source.bvhNodes;
+					pMesh->minAABB = source.minAABB;
+					pMesh->maxAABB = source.maxAABB;
+				}
+				else
+				{
+					if (!Utils::LoadMesh(std::string{ objFile }, *pMesh))
+						return reportError("cannot load mesh file");
+					loadedMeshFiles.emplace(std::string{ objFile }, meshIndex);
+				}
+
+				pMesh->Scale(scale);
+				pMesh->Translate(pose.translation);
+				pMesh->RotateX(pose.rotation.x);
+				pMesh->RotateY(pose.rotation.y);
+				pMesh->RotateZ(pose.rotation.z);
+				pMesh->UpdateTransforms();
+
+				meshIndices[std::string{ name }] = meshIndex;
+				m_MeshPoses.resize(m_TriangleMeshGeometries.size());
+				m_MeshPoses[meshIndex] = pose;
+			}
+			else if (command == "animate")
+			{
+				std::string_view meshName{}, channelName{}, curveName{};
+				if (!TryParseToken(pLine, pEnd, meshName) || !TryParseToken(pLine, pEnd, channelName) || !TryParseToken(pLine, pEnd, curveName))
+					return reportError("expected: animate <mesh> <channel> linear <speed> | sine <amplitude> <frequency>");
+
+				const auto meshIt{ meshIndices.find(meshName) };
+				if (meshIt == meshIndices.end())
+					return reportError("unknown mesh");
+
+				AnimationTrack track{};
+				track.meshIndex = meshIt->second;
+
+				constexpr std::string_view channelNames[]{ "rotatex", "rotatey", "rotatez", "translatex", "translatey", "translatez" };
+				const auto channelIt{ std::find(std::begin(channelNames), std::end(channelNames), channelName) };
+				if (channelIt == std::end(channelNames))
+					return reportError("channel must be rotatex|rotatey|rotatez|translatex|translatey|translatez");
+				track.channel = AnimationChannel(channelIt - std::begin(channelNames));
+
+				if (curveName == "linear" && parseFloats(pLine, { &track.amplitude }))
+					track.curve = AnimationCurve::Linear;
+				else if (curveName == "sine" && parseFloats(pLine, { &track.amplitude, &track.frequency }))
+					track.curve = AnimationCurve::Sine;
+				else
+					return reportError("expected: linear <speed> | sine <amplitude> <frequency>");
+
+				//Rotations are given in degrees
+				if (track.channel <= AnimationChannel::RotateZ) track.amplitude *= TO_RADIANS;
+				m_AnimationTracks.push_back(track);
+			}
+			else if (command == "camera")
+			{
+				Vector3 origin{};
+				float fov{};
+				if (!parseFloats(pLine, { &origin.x, &origin.y, &origin.z, &fov }))
+					return reportError("expected: camera <x> <y> <z> <fov> [pitch yaw]");
+				m_Camera.origin = origin;
+				m_Camera.UpdateFOV(fov);
+
+				//Optional orientation in degrees, Camera::Update rebuilds forward from these
+				float pitch{}, yaw{};
+				if (parseFloats(pLine, { &pitch, &yaw }))
+				{
+					m_Camera.totalPitch = pitch;
+					m_Camera.totalYaw = yaw;
+				}
+			}
+			else return reportError("unknown command");
+		}
+		return true;
+	}
+
+	void dae::Scene_File::Update(dae::Timer* pTimer)
+	{
+		Scene::Update(pTimer);
+		if (m_AnimationTracks.empty()) return;
+
+		std::copy(m_MeshPoses.begin(), m_MeshPoses.end(), m_AnimatedPoses.begin());
+		std::fill(m_IsMeshAnimated.begin(), m_IsMeshAnimated.end(), uint8_t{ 0 });
+		const float totalTime{ pTimer->GetTotal() };
+		for (const AnimationTrack& track : m_AnimationTracks)
+		{
+			const float value{ (track.curve == AnimationCurve::Linear) ?
+				track.amplitude * totalTime :
+				track.amplitude * sinf(PI_2 * track.frequency * totalTime) };
+
+			MeshPose& pose{ m_AnimatedPoses[track.meshIndex] };
+			switch (track.channel)
+			{
+			case AnimationChannel::RotateX: pose.rotation.x += value; break;
+			case AnimationChannel::RotateY: pose.rotation.y += value; break;
+			case AnimationChannel::RotateZ: pose.rotation.z += value; break;
+			case AnimationChannel::TranslateX: pose.translation.x += value; break;
+			case AnimationChannel::TranslateY: pose.translation.y += value; break;
+			case AnimationChannel::TranslateZ: pose.translation.z += value; break;
+			}
+			m_IsMeshAnimated[track.meshIndex] = 1;
+		}
+
+		for (size_t meshIndex = 0; meshIndex < m_AnimatedPoses.size(); ++meshIndex)
+		{
+			if (!m_IsMeshAnimated[meshIndex]) continue;
+
+			const MeshPose& pose{ m_AnimatedPoses[meshIndex] };
+			TriangleMesh& mesh{ m_TriangleMeshGeometries[meshIndex] };
+			mesh.Translate(pose.translation);
+			mesh.RotateX(pose.rotation.x);
+			mesh.RotateY(pose.rotation.y);
+			mesh.RotateZ(pose.rotation.z);
+			mesh.UpdateTransforms();
+		}
+	}
+#pragma endregion
+
+#pragma region SCENE STRESS
+	Scene_Stress::Scene_Stress(const StressSceneSettings& settings) :
+		m_Settings(settings)
+	{
+	}
+
+	void Scene_Stress::Initialize()
+	{
+		sceneName = "Stress";
+		const float extent{ m_Settings.extent };
+		const Vector3 center{ 0.f, extent, extent };
+
+		//Same framing as the room scenes (0,3,-9) for the default extent
+		m_Camera.origin = { 0.f, extent * 0.6f, -extent * 1.8f };
+		m_Camera.UpdateFOV(45.f);
+
+		std::mt19937 rng{ m_Settings.seed };
+		std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+		std::uniform_real_distribution<float> signedUnit{ -1.f, 1.f };
+
+		//Materials
+		const auto matLambert_GrayBlue = AddMaterial(Material::CreateLambert({ .49f, 0.57f, 0.57f }, 1.f));
+		std::vector<MaterialId> objectMaterials{};
+		for (int i = 0; i < 8; ++i)
+		{
+			const ColorRGB albedo{ .2f + .8f * unit(rng), .2f + .8f * unit(rng), .2f + .8f * unit(rng) };
+			if (i % 2 == 0) objectMaterials.push_back(AddMaterial(Material::CreateLambert(albedo, 1.f)));
+			else objectMaterials.push_back(AddMaterial(Material::CreateCookTorrence(albedo, float(i % 4 == 1), .1f + .9f * unit(rng))));
+		}
+
+		//Room
+		AddPlane(Vector3{ 0.f, 0.f, 2.f * extent }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
+		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
+		AddPlane(Vector3{ 0.f, 2.f * extent, 0.f }, Vector3{ 0.f, -1.f, 0.f }, matLambert_GrayBlue); //TOP
+		AddPlane(Vector3{ extent, 0.f, 0.f }, Vector3{ -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
+		AddPlane(Vector3{ -extent, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
+
+		//Placement for object i out of count, inside the room with a margin
+		const float innerExtent{ extent * 0.9f };
+		std::vector<Vector3> clusterCenters{};
+		const auto generatePosition = [&](int index, int count)
+		{
+			switch (m_Settings.distribution)
+			{
+			case StressDistribution::Clustered:
+			{
+				if (clusterCenters.empty())
+				{
+					const int clusterCount{ std::max(1, count / 64) };
+					for (int i = 0; i < clusterCount; ++i)
+						clusterCenters.push_back(center + innerExtent * 0.8f * Vector3{ signedUnit(rng), signedUnit(rng), signedUnit(rng) });
+				}
+				std::normal_distribution<float> offset{ 0.f, extent * 0.1f };
+				const Vector3 position{ clusterCenters[rng() % clusterCenters.size()] + Vector3{ offset(rng), offset(rng), offset(rng) } };
+				return Vector3::Max(center - Vector3{ innerExtent, innerExtent, innerExtent },
+					Vector3::Min(center + Vector3{ innerExtent, innerExtent, innerExtent }, position));
+			}
+			case StressDistribution::Grid:
+			{
+				const int cellsPerAxis{ std::max(1, static_cast<int>(std::ceil(std::cbrt(float(count))))) };
+				const float cellSize{ 2.f * innerExtent / cellsPerAxis };
+				const Vector3 cell{ float(index % cellsPerAxis), float(index / cellsPerAxis % cellsPerAxis), float(index / (cellsPerAxis * cellsPerAxis)) };
+				return center - Vector3{ innerExtent, innerExtent, innerExtent } + (cell + Vector3{ .5f, .5f, .5f }) * cellSize;
+			}
+			case StressDistribution::Uniform:
+			default:
+				return center + innerExtent * Vector3{ signedUnit(rng), signedUnit(rng), signedUnit(rng) };
+			}
+		};
+
+		//Spheres, sized so the volume stays roughly equally filled whatever the count
+		m_SphereGeometries.reserve(m_Settings.sphereCount);
+		const float maxRadius{ std::min(extent * 0.15f, extent * 0.5f / std::cbrt(float(std::max(1, m_Settings.sphereCount)))) };
+		for (int i = 0; i < m_Settings.sphereCount; ++i)
+		{
+			AddSphere(generatePosition(i, m_Settings.sphereCount), maxRadius * (.3f + .7f * unit(rng)), objectMaterials[rng() % objectMaterials.size()]);
+		}
+
+		//Mesh instances, cycling through every OBJ in the mesh directory
+		std::vector<std::string> meshFiles{};
+		std::error_code error{};
+		for (const auto& entry : std::filesystem::directory_iterator(m_Settings.meshDirectory, error))
+		{
+			if (entry.path().extension() == ".obj") meshFiles.push_back(entry.path().generic_string());
+		}
+		std::sort(meshFiles.begin(), meshFiles.end());
+
+		if (!meshFiles.empty())
+		{
+			m_TriangleMeshGeometries.reserve(m_Settings.meshInstanceCount);
+			std::vector<size_t> firstInstances(meshFiles.size(), SIZE_MAX);
+			const float meshSize{ extent / std::cbrt(float(std::max(1, m_Settings.meshInstanceCount))) };
+			for (int i = 0; i < m_Settings.meshInstanceCount; ++i)
+			{
+				const size_t fileIndex{ i % meshFiles.size() };
+				TriangleMesh* pMesh{ AddTriangleMesh(TriangleCullMode::BackFaceCulling, objectMaterials[rng() % objectMaterials.size()]) };
+				if (firstInstances[fileIndex] != SIZE_MAX)
+				{
+					const TriangleMesh& source{ m_TriangleMeshGeometries[firstInstances[fileIndex]] };
+					pMesh->positions = source.positions;
+					pMesh->indices = source.indices;
+					pMesh->bvhNodes = source.bvhNodes;
+					pMesh->minAABB = source.minAABB;
+					pMesh->maxAABB = source.maxAABB;
+				}
+				else if (Utils::LoadMesh(meshFiles[fileIndex], *pMesh))
+					firstInstances[fileIndex] = m_TriangleMeshGeometries.size() - 1;
+				else std::cout << "Stress scene: cannot load " << meshFiles[fileIndex] << "\n";
+
+				const Vector3 size{ pMesh->maxAABB - pMesh->minAABB };
+				const float largestSide{ std::max(size.x, std::max(size.y, size.z)) };
+				const float scale{ largestSide > 0.f ? meshSize / largestSide : 1.f };
+				pMesh->Scale({ scale, scale, scale });
+				pMesh->RotateY(PI_2 * unit(rng));
+				pMesh->Translate(generatePosition(i, m_Settings.meshInstanceCount));
+				pMesh->UpdateTransforms();
+			}
+		}
+
+		//Lights, the total power is kept roughly constant so the image does not saturate
+		m_Lights.reserve(m_Settings.pointLightCount + m_Settings.directionalLightCount);
+		const float pointIntensity{ 150.f / std::max(1, m_Settings.pointLightCount) };
+		for (int i = 0; i < m_Settings.pointLightCount; ++i)
+		{
+			const ColorRGB color{ .5f + .5f * unit(rng), .5f + .5f * unit(rng), .5f + .5f * unit(rng) };
+			AddPointLight(generatePosition(i, m_Settings.pointLightCount), pointIntensity, color);
+		}
+		const float directionalIntensity{ 2.f / std::max(1, m_Settings.directionalLightCount) };
+		for (int i = 0; i < m_Settings.directionalLightCount; ++i)
+		{
+			//Pointing down into the room, the light direction points from the surface towards the light
+			const Vector3 direction{ Vector3{ signedUnit(rng), .5f + .5f * unit(rng), -unit(rng) }.Normalized() };
+			AddDirectionalLight(direction, directionalIntensity, colors::White);
+		}
+	}
+#pragma endregion
+}
@@ -1,16 +1,17 @@
 #pragma once
+#include <span>
 #include <string>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "Material.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
@@ -28,6 +29,8 @@ namespace dae
 		Scene& operator=(Scene&&) noexcept = delete;
 
 		virtual void Initialize() = 0;
+		//False when Initialize could not build the whole scene, rendering the rest would show a different one
+		virtual bool IsLoaded() const { return true; }
 		virtual void Update(dae::Timer* pTimer)
 		{
 			m_Camera.Update(pTimer);
@@ -36,11 +39,24 @@ namespace dae
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(const Ray& ray) const;
+		//Any-hit query that tries lastOccluder first and stores the blocking primitive in it
+		bool DoesHit(const Ray& ray, Occluder& lastOccluder) const;
+		//Any-hit queries of rays from one origin that all end at maxDistance, returns how many are blocked.
+		//Geometry farther away than that is culled once for all of them, short rays then only test their surroundings
+		uint32_t CountOccludedRays(const Vector3& origin, std::span<const Vector3> directions, float maxDistance) const;
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material>& GetMaterials() const { return m_Materials; }
+		const std::string& GetSceneName() const { return sceneName; }
+
+		//Changes whenever a mesh is transformed, spheres and planes are static
+		uint32_t GetGeometryVersion() const;
+
+		//Bounds every point light to the distance where its radiance drops below threshold, 0 makes them unbounded again
+		void SetLightCutoff(float threshold);
 
 	protected:
 		std::string	sceneName;
@@ -49,19 +65,24 @@ namespace dae
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		std::vector<Material> m_Materials{};
 
 		std::vector<Triangle> m_Triangles{};
 
+		bool IsOccludedBy(const Ray& ray, const Occluder& occluder) const;
+
 		Camera m_Camera{};
 
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
-		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		Sphere* AddSphere(const Vector3& origin, float radius, MaterialId materialIndex = 0);
+		Plane* AddPlane(const Vector3& origin, const Vector3& normal, MaterialId materialIndex = 0);
+		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, MaterialId materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		Light* AddSphereLight(const Vector3& origin, float radius, float intensity, const ColorRGB& color);
+		//Emits on the side of edgeX x edgeY, edgeY is made perpendicular to edgeX
+		Light* AddQuadLight(const Vector3& origin, const Vector3& edgeX, const Vector3& edgeY, float intensity, const ColorRGB& color);
+		MaterialId AddMaterial(const Material& material);
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -175,4 +196,104 @@ namespace dae
 		float m_TotalYTime{};
 		float m_ChangeInterval{ 6.f };
 	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Scene loaded from a text description file (see Resources/*.scene for the format)
+	class Scene_File final : public Scene
+	{
+	public:
+		explicit Scene_File(const std::string& filename);
+		~Scene_File() override = default;
+
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
+
+		void Initialize() override;
+		virtual void Update(dae::Timer* pTimer) override;
+
+		bool IsLoaded() const override { return m_IsLoaded; }
+
+	private:
+		enum class AnimationChannel
+		{
+			RotateX,
+			RotateY,
+			RotateZ,
+			TranslateX,
+			TranslateY,
+			TranslateZ
+		};
+
+		enum class AnimationCurve
+		{
+			Linear, //value = speed * time
+			Sine //value = amplitude * sin(2PI * frequency * time)
+		};
+
+		struct AnimationTrack
+		{
+			size_t meshIndex{};
+			AnimationChannel channel{};
+			AnimationCurve curve{};
+			float amplitude{};
+			float frequency{};
+		};
+
+		//Transform a mesh was declared with, animation tracks are applied on top of it
+		struct MeshPose
+		{
+			Vector3 translation{};
+			Vector3 rotation{}; //pitch, yaw, roll in radians
+		};
+
+		std::string m_Filename{};
+		std::vector<AnimationTrack> m_AnimationTracks{};
+		std::vector<MeshPose> m_MeshPoses{};
+		//Poses of the current frame, sized once after loading so Update does not allocate
+		std::vector<MeshPose> m_AnimatedPoses{};
+		std::vector<uint8_t> m_IsMeshAnimated{};
+		bool m_IsLoaded{ false };
+
+		bool LoadFile();
+	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Procedurally generated scene for scaling benchmarks
+	enum class StressDistribution
+	{
+		Uniform, //Evenly spread over the volume
+		Clustered, //Gaussian clumps around random centers
+		Grid //Regular lattice
+	};
+
+	struct StressSceneSettings
+	{
+		int sphereCount{ 1000 };
+		int meshInstanceCount{ 4 };
+		int pointLightCount{ 8 };
+		int directionalLightCount{ 0 };
+		StressDistribution distribution{ StressDistribution::Uniform };
+		float extent{ 5.f }; //Half size of the room the content is spread in
+		uint32_t seed{ 1337 };
+		std::string meshDirectory{ "Resources" }; //Every .obj in here is instanced in turn
+	};
+
+	class Scene_Stress final : public Scene
+	{
+	public:
+		explicit Scene_Stress(const StressSceneSettings& settings);
+		~Scene_Stress() override = default;
+
+		Scene_Stress(const Scene_Stress&) = delete;
+		Scene_Stress(Scene_Stress&&) noexcept = delete;
+		Scene_Stress& operator=(const Scene_Stress&) = delete;
+		Scene_Stress& operator=(Scene_Stress&&) noexcept = delete;
+
+		void Initialize() override;
+
+	private:
+		StressSceneSettings m_Settings{};
+	};
 }
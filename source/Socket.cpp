@@ -0,0 +1,222 @@
+#include "Socket.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+#if defined(_WIN32)
+		using NativeSocket = SOCKET;
+		constexpr int SEND_FLAGS{ 0 };
+
+		void EnsureInitialized()
+		{
+			static const bool isInitialized{ []
+				{
+					WSADATA data{};
+					return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+				}() };
+			(void)isInitialized;
+		}
+
+		bool WouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+		int PollSockets(pollfd* pFds, size_t count, int timeoutMs) { return WSAPoll(pFds, static_cast<ULONG>(count), timeoutMs); }
+		void CloseNative(NativeSocket socket) { closesocket(socket); }
+#else
+		using NativeSocket = int;
+		//A closed peer reports an error instead of raising SIGPIPE
+		constexpr int SEND_FLAGS{ MSG_NOSIGNAL };
+
+		void EnsureInitialized() {}
+		bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+		int PollSockets(pollfd* pFds, size_t count, int timeoutMs) { return poll(pFds, count, timeoutMs); }
+		void CloseNative(NativeSocket socket) { close(socket); }
+#endif
+
+		NativeSocket ToNative(intptr_t handle) { return static_cast<NativeSocket>(handle); }
+
+		void DisableNagle(NativeSocket socket)
+		{
+			//Tile jobs and results are small and latency bound
+			int isEnabled{ 1 };
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&isEnabled), sizeof(isEnabled));
+		}
+	}
+
+	Socket::~Socket()
+	{
+		Close();
+	}
+
+	Socket::Socket(Socket&& other) noexcept :
+		m_Handle{ other.m_Handle }
+	{
+		other.m_Handle = INVALID_HANDLE;
+	}
+
+	Socket& Socket::operator=(Socket&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			m_Handle = other.m_Handle;
+			other.m_Handle = INVALID_HANDLE;
+		}
+		return *this;
+	}
+
+	Socket Socket::Listen(uint16_t port, bool isLocalOnly)
+	{
+		EnsureInitialized();
+		const NativeSocket listener{ socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) };
+		Socket result{ static_cast<intptr_t>(listener) };
+		if (!result.IsValid())
+			return {};
+
+		int reuseAddress{ 1 };
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(isLocalOnly ? INADDR_LOOPBACK : INADDR_ANY);
+		address.sin_port = htons(port);
+		if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+			return {};
+		return result;
+	}
+
+	Socket Socket::Connect(const std::string& host, uint16_t port)
+	{
+		EnsureInitialized();
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		addrinfo* pAddresses{};
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pAddresses) != 0)
+			return {};
+
+		Socket result{};
+		for (const addrinfo* pAddress{ pAddresses }; pAddress && !result.IsValid(); pAddress = pAddress->ai_next)
+		{
+			const NativeSocket connection{ socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol) };
+			Socket candidate{ static_cast<intptr_t>(connection) };
+			if (candidate.IsValid() && connect(connection, pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0)
+			{
+				DisableNagle(connection);
+				result = std::move(candidate);
+			}
+		}
+		freeaddrinfo(pAddresses);
+		return result;
+	}
+
+	Socket Socket::Accept() const
+	{
+		const NativeSocket connection{ accept(ToNative(m_Handle), nullptr, nullptr) };
+		Socket result{ static_cast<intptr_t>(connection) };
+		if (result.IsValid())
+			DisableNagle(connection);
+		return result;
+	}
+
+	void Socket::Close()
+	{
+		if (IsValid())
+			CloseNative(ToNative(m_Handle));
+		m_Handle = INVALID_HANDLE;
+	}
+
+	void Socket::SetNonBlocking(bool isNonBlocking)
+	{
+#if defined(_WIN32)
+		u_long mode{ isNonBlocking ? 1ul : 0ul };
+		ioctlsocket(ToNative(m_Handle), FIONBIO, &mode);
+#else
+		const int flags{ fcntl(m_Handle, F_GETFL, 0) };
+		fcntl(m_Handle, F_SETFL, isNonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+#endif
+	}
+
+	bool Socket::SendAll(const void* pData, size_t size)
+	{
+		const char* pBytes{ static_cast<const char*>(pData) };
+		while (size > 0 && IsValid())
+		{
+			const auto sent{ send(ToNative(m_Handle), pBytes, static_cast<int>(size), SEND_FLAGS) };
+			if (sent > 0)
+			{
+				pBytes += sent;
+				size -= static_cast<size_t>(sent);
+			}
+			else if (sent < 0 && WouldBlock())
+			{
+				//A peer that stopped reading for this long is treated as gone
+				pollfd descriptor{ ToNative(m_Handle), POLLOUT, 0 };
+				if (PollSockets(&descriptor, 1, SEND_TIMEOUT_MS) <= 0)
+					return false;
+			}
+			else return false;
+		}
+		return size == 0;
+	}
+
+	bool Socket::ReceiveAll(void* pData, size_t size)
+	{
+		char* pBytes{ static_cast<char*>(pData) };
+		while (size > 0 && IsValid())
+		{
+			const auto received{ recv(ToNative(m_Handle), pBytes, static_cast<int>(size), 0) };
+			if (received <= 0)
+				return false;
+			pBytes += received;
+			size -= static_cast<size_t>(received);
+		}
+		return size == 0;
+	}
+
+	bool Socket::ReceiveAvailable(std::vector<uint8_t>& buffer)
+	{
+		char chunk[64 * 1024];
+		while (IsValid())
+		{
+			const auto received{ recv(ToNative(m_Handle), chunk, static_cast<int>(sizeof(chunk)), 0) };
+			if (received > 0)
+				buffer.insert(buffer.end(), chunk, chunk + received);
+			else if (received < 0 && WouldBlock())
+				return true;
+			else return false;
+		}
+		return false;
+	}
+
+	void Socket::WaitReadable(std::span<Socket* const> sockets, int timeoutMs, std::vector<uint8_t>& readable)
+	{
+		std::vector<pollfd> descriptors(sockets.size());
+		for (size_t index{}; index < sockets.size(); ++index)
+			descriptors[index] = { ToNative(sockets[index]->m_Handle), POLLIN, 0 };
+		const int readyCount{ PollSockets(descriptors.data(), descriptors.size(), timeoutMs) };
+
+		readable.assign(sockets.size(), 0);
+		for (size_t index{}; index < sockets.size() && readyCount > 0; ++index)
+			readable[index] = (descriptors[index].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+	}
+}
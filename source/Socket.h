@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	//TCP connection or listening socket, closed on destruction
+	class Socket final
+	{
+	public:
+		Socket() = default;
+		~Socket();
+
+		Socket(const Socket&) = delete;
+		Socket(Socket&& other) noexcept;
+		Socket& operator=(const Socket&) = delete;
+		Socket& operator=(Socket&& other) noexcept;
+
+		//Listens on the loopback interface only unless isLocalOnly is false, invalid on failure
+		static Socket Listen(uint16_t port, bool isLocalOnly = true);
+		static Socket Connect(const std::string& host, uint16_t port);
+		//Next pending connection of a listening socket, invalid when there is none and the socket is non-blocking
+		Socket Accept() const;
+
+		bool IsValid() const { return m_Handle != INVALID_HANDLE; }
+		void Close();
+		void SetNonBlocking(bool isNonBlocking);
+
+		//Sends all of it, waiting while the send buffer is full. False once the connection failed or stalled
+		bool SendAll(const void* pData, size_t size);
+		//Blocks until size bytes arrived, false when the connection closed first
+		bool ReceiveAll(void* pData, size_t size);
+		//Appends what arrived without blocking, false when the connection closed or failed
+		bool ReceiveAvailable(std::vector<uint8_t>& buffer);
+
+		//Waits until at least one of the sockets can be read or timeoutMs passed, readable receives one flag per socket
+		static void WaitReadable(std::span<Socket* const> sockets, int timeoutMs, std::vector<uint8_t>& readable);
+
+	private:
+		static constexpr intptr_t INVALID_HANDLE{ -1 };
+		static constexpr int SEND_TIMEOUT_MS{ 5000 };
+
+		explicit Socket(intptr_t handle) : m_Handle{ handle } {}
+
+		intptr_t m_Handle{ INVALID_HANDLE };
+	};
+}
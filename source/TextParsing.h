@@ -0,0 +1,75 @@
+#pragma once
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+namespace dae
+{
+	//Allocation free helpers for line based text formats (OBJ, scene files), all of them stop at pEnd and never skip a '\n'
+	namespace TextParsing
+	{
+		inline bool IsBlank(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		inline const char* SkipBlanks(const char* pCurr, const char* pEnd)
+		{
+			while (pCurr < pEnd && IsBlank(*pCurr)) ++pCurr;
+			return pCurr;
+		}
+
+		//Returns the start of the next line
+		inline const char* SkipLine(const char* pCurr, const char* pEnd)
+		{
+			const char* pNewLine = static_cast<const char*>(memchr(pCurr, '\n', pEnd - pCurr));
+			return pNewLine ? pNewLine + 1 : pEnd;
+		}
+
+		//True when only blanks or a comment are left on the line
+		inline bool IsEndOfLine(const char* pCurr, const char* pEnd)
+		{
+			pCurr = SkipBlanks(pCurr, pEnd);
+			return pCurr >= pEnd || *pCurr == '\n' || *pCurr == '#';
+		}
+
+		inline bool TryParseFloat(const char*& pCurr, const char* pEnd, float& value)
+		{
+			const char* pStart{ SkipBlanks(pCurr, pEnd) };
+			//from_chars does not accept a leading '+'
+			if (pStart < pEnd && *pStart == '+') ++pStart;
+			const auto [pNext, errorCode] = std::from_chars(pStart, pEnd, value);
+			if (errorCode != std::errc{}) return false;
+			pCurr = pNext;
+			return true;
+		}
+
+		inline bool TryParseInt(const char*& pCurr, const char* pEnd, int& value)
+		{
+			const char* pStart{ SkipBlanks(pCurr, pEnd) };
+			if (pStart < pEnd && *pStart == '+') ++pStart;
+			const auto [pNext, errorCode] = std::from_chars(pStart, pEnd, value);
+			if (errorCode != std::errc{}) return false;
+			pCurr = pNext;
+			return true;
+		}
+
+		//Lenient version, a missing or malformed value reads as 0
+		inline const char* ParseFloat(const char* pCurr, const char* pEnd, float& value)
+		{
+			if (!TryParseFloat(pCurr, pEnd, value)) value = 0.f;
+			return pCurr;
+		}
+
+		//Reads the next whitespace separated word, empty at the end of the line
+		inline bool TryParseToken(const char*& pCurr, const char* pEnd, std::string_view& token)
+		{
+			const char* pStart{ SkipBlanks(pCurr, pEnd) };
+			const char* pStop{ pStart };
+			while (pStop < pEnd && !IsBlank(*pStop) && *pStop != '\n') ++pStop;
+			token = std::string_view{ pStart, static_cast<size_t>(pStop - pStart) };
+			pCurr = pStop;
+			return !token.empty();
+		}
+	}
+}
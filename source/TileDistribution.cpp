@@ -0,0 +1,432 @@
+#include "TileDistribution.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace dae
+{
+	namespace
+	{
+		//Structs are sent as they are in memory, every process has to run the same build
+		constexpr uint32_t PROTOCOL_VERSION{ 7 };
+
+		enum class MessageType : uint32_t
+		{
+			Hello, //Worker to coordinator once connected
+			Frame, //Scene state of the next frame, sent to every worker before its jobs
+			Job, //Followed by the tile indices
+			Result //Followed by Renderer::GetTileWordCount words per tile, in job order
+		};
+
+		struct MessageHeader
+		{
+			MessageType type{};
+			uint32_t size{}; //Bytes after the header
+		};
+
+		struct HelloMessage
+		{
+			uint32_t version{};
+			uint32_t tileCount{};
+		};
+
+		struct FrameMessage
+		{
+			uint32_t frameNumber{};
+			float totalTime{};
+			float elapsedTime{};
+			Vector3 cameraOrigin{};
+			float cameraPitch{};
+			float cameraYaw{};
+			float cameraFovAngle{};
+			Renderer::Settings settings{};
+			//Sample of the pixel sequences in progressive modes, the coordinator accumulates the results
+			uint32_t sampleIndex{};
+		};
+
+		struct JobMessage
+		{
+			uint32_t frameNumber{};
+			uint32_t jobIndex{};
+			uint32_t tileCount{};
+		};
+
+		struct ResultMessage
+		{
+			uint32_t frameNumber{};
+			uint32_t jobIndex{};
+			uint32_t tileCount{};
+		};
+
+		//Larger bodies mean a corrupt stream
+		constexpr uint32_t MAX_MESSAGE_SIZE{ 64 * 1024 * 1024 };
+
+		template<typename T>
+		void AppendMessage(std::vector<uint8_t>& out, MessageType type, const T& message, const void* pPayload = nullptr, size_t payloadSize = 0)
+		{
+			const MessageHeader header{ type, static_cast<uint32_t>(sizeof(T) + payloadSize) };
+			const uint8_t* pHeader{ reinterpret_cast<const uint8_t*>(&header) };
+			const uint8_t* pMessage{ reinterpret_cast<const uint8_t*>(&message) };
+			out.insert(out.end(), pHeader, pHeader + sizeof(header));
+			out.insert(out.end(), pMessage, pMessage + sizeof(T));
+			if (payloadSize > 0)
+				out.insert(out.end(), static_cast<const uint8_t*>(pPayload), static_cast<const uint8_t*>(pPayload) + payloadSize);
+		}
+
+		float SecondsSince(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	TileCoordinator::TileCoordinator(uint16_t port, bool isLocalOnly) :
+		m_Listener{ Socket::Listen(port, isLocalOnly) }
+	{
+		if (m_Listener.IsValid())
+			m_Listener.SetNonBlocking(true);
+	}
+
+	void TileCoordinator::WaitForWorkers(size_t workerCount, float timeoutSeconds, Renderer* pRenderer)
+	{
+		const auto start{ Clock::now() };
+		std::vector<Socket*> sockets{};
+		std::vector<uint8_t> readable{};
+		while (SecondsSince(start) < timeoutSeconds &&
+			std::count_if(m_Workers.begin(), m_Workers.end(), [](const WorkerConnection& worker) { return worker.hasSaidHello; }) < ptrdiff_t(workerCount))
+		{
+			AcceptWorkers();
+			sockets.clear();
+			for (WorkerConnection& worker : m_Workers)
+				sockets.push_back(&worker.socket);
+			sockets.push_back(&m_Listener);
+			Socket::WaitReadable(sockets, 50, readable);
+
+			//Only hellos arrive before the first frame, results are never written
+			for (size_t workerIndex{ m_Workers.size() }; workerIndex-- > 0;)
+			{
+				if (readable[workerIndex] && !ReceiveMessages(m_Workers[workerIndex], pRenderer))
+					DropWorker(workerIndex);
+			}
+		}
+	}
+
+	void TileCoordinator::RenderFrame(Scene* pScene, const Timer* pTimer, Renderer* pRenderer)
+	{
+		const std::span<const uint32_t> tileOrder{ pRenderer->GetTileOrder() };
+
+		//Consecutive tiles of the Morton order form compact jobs
+		++m_FrameNumber;
+		m_Jobs.clear();
+		m_PendingJobs.clear();
+		m_DoneJobCount = 0;
+		for (uint32_t firstTile{}; firstTile < tileOrder.size(); firstTile += JOB_TILE_COUNT)
+		{
+			m_PendingJobs.push_back(static_cast<uint32_t>(m_Jobs.size()));
+			m_Jobs.push_back({ firstTile, std::min(JOB_TILE_COUNT, static_cast<uint32_t>(tileOrder.size()) - firstTile) });
+		}
+
+		const uint32_t sampleIndex{ pRenderer->BeginDistributedFrame(pScene) };
+		const Camera& camera{ pScene->GetCamera() };
+		const FrameMessage frame{ m_FrameNumber, pTimer->GetTotal(), pTimer->GetElapsed(), camera.origin,
+			camera.totalPitch, camera.totalYaw, camera.fovAngle, Renderer::GetSettings(), sampleIndex };
+		m_FrameMessage.clear();
+		AppendMessage(m_FrameMessage, MessageType::Frame, frame);
+
+		AcceptWorkers();
+		for (size_t workerIndex{ m_Workers.size() }; workerIndex-- > 0;)
+		{
+			WorkerConnection& worker{ m_Workers[workerIndex] };
+			if (worker.hasSaidHello && !worker.socket.SendAll(m_FrameMessage.data(), m_FrameMessage.size()))
+				DropWorker(workerIndex);
+		}
+
+		std::vector<Socket*> sockets{};
+		std::vector<uint8_t> readable{};
+		while (m_DoneJobCount < m_Jobs.size())
+		{
+			DispatchJobs(tileOrder);
+
+			const bool hasWorkers{ std::any_of(m_Workers.begin(), m_Workers.end(), [](const WorkerConnection& worker) { return worker.hasSaidHello; }) };
+			if (!hasWorkers)
+			{
+				//Nobody left to render the rest, trace it here
+				std::vector<uint32_t> tiles{};
+				for (Job& job : m_Jobs)
+				{
+					if (!job.isDone)
+						tiles.insert(tiles.end(), tileOrder.begin() + job.firstTile, tileOrder.begin() + job.firstTile + job.tileCount);
+				}
+				pRenderer->RenderTiles(pScene, tiles, sampleIndex);
+				break;
+			}
+
+			sockets.clear();
+			for (WorkerConnection& worker : m_Workers)
+				sockets.push_back(&worker.socket);
+			sockets.push_back(&m_Listener);
+			Socket::WaitReadable(sockets, 5, readable);
+
+			for (size_t workerIndex{ m_Workers.size() }; workerIndex-- > 0;)
+			{
+				if (readable[workerIndex] && !ReceiveMessages(m_Workers[workerIndex], pRenderer))
+					DropWorker(workerIndex);
+			}
+			if (readable.back())
+				AcceptWorkers();
+		}
+
+		pRenderer->EndDistributedFrame();
+		pRenderer->PresentFrame();
+	}
+
+	void TileCoordinator::AcceptWorkers()
+	{
+		for (Socket connection{ m_Listener.Accept() }; connection.IsValid(); connection = m_Listener.Accept())
+		{
+			connection.SetNonBlocking(true);
+			m_Workers.push_back({ std::move(connection) });
+		}
+	}
+
+	bool TileCoordinator::ReceiveMessages(WorkerConnection& worker, Renderer* pRenderer)
+	{
+		if (!worker.socket.ReceiveAvailable(worker.received))
+			return false;
+
+		size_t offset{};
+		while (worker.received.size() - offset >= sizeof(MessageHeader))
+		{
+			MessageHeader header{};
+			memcpy(&header, worker.received.data() + offset, sizeof(header));
+			if (header.size > MAX_MESSAGE_SIZE)
+				return false;
+			if (worker.received.size() - offset - sizeof(header) < header.size)
+				break;
+			const uint8_t* pBody{ worker.received.data() + offset + sizeof(header) };
+			offset += sizeof(header) + header.size;
+
+			switch (header.type)
+			{
+			case MessageType::Hello:
+			{
+				HelloMessage hello{};
+				if (header.size != sizeof(hello))
+					return false;
+				memcpy(&hello, pBody, sizeof(hello));
+				if (hello.version != PROTOCOL_VERSION || hello.tileCount != pRenderer->GetTileCount())
+				{
+					std::cout << "Tile worker rejected, it renders a different build or resolution\n";
+					return false;
+				}
+				worker.hasSaidHello = true;
+				//Joins the running frame
+				if (!m_FrameMessage.empty() && !worker.socket.SendAll(m_FrameMessage.data(), m_FrameMessage.size()))
+					return false;
+				break;
+			}
+			case MessageType::Result:
+			{
+				ResultMessage result{};
+				if (header.size < sizeof(result))
+					return false;
+				memcpy(&result, pBody, sizeof(result));
+				std::erase_if(worker.jobsInFlight, [&result](const JobTicket& ticket)
+					{
+						return ticket.frameNumber == result.frameNumber && ticket.jobIndex == result.jobIndex;
+					});
+				if (result.frameNumber != m_FrameNumber || result.jobIndex >= m_Jobs.size())
+					break;
+
+				Job& job{ m_Jobs[result.jobIndex] };
+				const uint32_t wordCount{ Renderer::GetTileWordCount() };
+				if (result.tileCount != job.tileCount || header.size != sizeof(result) + job.tileCount * wordCount * sizeof(uint32_t))
+					return false;
+				if (job.isDone)
+					break;
+
+				const uint32_t* pPixels{ reinterpret_cast<const uint32_t*>(pBody + sizeof(result)) };
+				const std::span<const uint32_t> tileOrder{ pRenderer->GetTileOrder() };
+				for (uint32_t tile{}; tile < job.tileCount; ++tile)
+					pRenderer->WriteTile(tileOrder[job.firstTile + tile], { pPixels + tile * wordCount, wordCount });
+				job.isDone = true;
+				++m_DoneJobCount;
+
+				//Running average, straggler detection compares against it
+				const float jobSeconds{ SecondsSince(job.dispatchTime) };
+				m_AverageJobSeconds = m_AverageJobSeconds > 0.f ? m_AverageJobSeconds * 0.9f + jobSeconds * 0.1f : jobSeconds;
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		worker.received.erase(worker.received.begin(), worker.received.begin() + offset);
+		return true;
+	}
+
+	bool TileCoordinator::SendJob(WorkerConnection& worker, uint32_t jobIndex, std::span<const uint32_t> tileOrder)
+	{
+		Job& job{ m_Jobs[jobIndex] };
+		job.dispatchTime = Clock::now();
+		++job.dispatchCount;
+		worker.jobsInFlight.push_back({ m_FrameNumber, jobIndex, job.dispatchTime });
+
+		std::vector<uint8_t> message{};
+		AppendMessage(message, MessageType::Job, JobMessage{ m_FrameNumber, jobIndex, job.tileCount },
+			tileOrder.data() + job.firstTile, job.tileCount * sizeof(uint32_t));
+		return worker.socket.SendAll(message.data(), message.size());
+	}
+
+	void TileCoordinator::DispatchJobs(std::span<const uint32_t> tileOrder)
+	{
+		for (size_t workerIndex{ m_Workers.size() }; workerIndex-- > 0;)
+		{
+			WorkerConnection& worker{ m_Workers[workerIndex] };
+			if (!worker.hasSaidHello)
+				continue;
+			if (!worker.jobsInFlight.empty() && SecondsSince(worker.jobsInFlight.front().dispatchTime) > WORKER_TIMEOUT_SECONDS)
+			{
+				DropWorker(workerIndex);
+				continue;
+			}
+
+			bool isConnected{ true };
+			while (isConnected && worker.jobsInFlight.size() < MAX_JOBS_IN_FLIGHT && !m_PendingJobs.empty())
+			{
+				const uint32_t jobIndex{ m_PendingJobs.front() };
+				m_PendingJobs.pop_front();
+				if (!m_Jobs[jobIndex].isDone)
+					isConnected = SendJob(worker, jobIndex, tileOrder);
+			}
+
+			//Out of new work, an idle worker takes over the job that has been running the longest if it is overdue
+			if (isConnected && worker.jobsInFlight.empty() && m_PendingJobs.empty())
+			{
+				const float overdueSeconds{ std::max(MIN_STRAGGLER_SECONDS, m_AverageJobSeconds * STRAGGLER_FACTOR) };
+				Job* pStraggler{};
+				for (Job& job : m_Jobs)
+				{
+					if (!job.isDone && job.dispatchCount == 1 && SecondsSince(job.dispatchTime) > overdueSeconds &&
+						(!pStraggler || job.dispatchTime < pStraggler->dispatchTime))
+						pStraggler = &job;
+				}
+				if (pStraggler)
+					isConnected = SendJob(worker, static_cast<uint32_t>(pStraggler - m_Jobs.data()), tileOrder);
+			}
+
+			if (!isConnected)
+				DropWorker(workerIndex);
+		}
+	}
+
+	void TileCoordinator::DropWorker(size_t workerIndex)
+	{
+		//Its unfinished jobs go back to the front of the queue
+		for (const JobTicket& ticket : m_Workers[workerIndex].jobsInFlight)
+		{
+			if (ticket.frameNumber == m_FrameNumber && !m_Jobs[ticket.jobIndex].isDone)
+				m_PendingJobs.push_front(ticket.jobIndex);
+		}
+		m_Workers.erase(m_Workers.begin() + workerIndex);
+		std::cout << "Tile worker disconnected, " << m_Workers.size() << " left\n";
+	}
+
+	int RunTileWorker(const std::string& address, Scene* pScene, Renderer* pRenderer, Timer* pTimer)
+	{
+		const size_t separator{ address.find_last_of(':') };
+		if (separator == std::string::npos)
+		{
+			std::cout << "Tile worker needs host:port, got " << address << "\n";
+			return 1;
+		}
+		const std::string host{ address.substr(0, separator) };
+		const char* pPortEnd{ address.data() + address.size() };
+		uint32_t port{};
+		const auto [pParsed, error] { std::from_chars(address.data() + separator + 1, pPortEnd, port) };
+		if (error != std::errc{} || pParsed != pPortEnd || port == 0 || port > 65535)
+		{
+			std::cout << "Tile worker needs a port from 1 to 65535, got " << address << "\n";
+			return 1;
+		}
+
+		//Workers are usually started together with the coordinator, give it a moment to listen
+		Socket connection{};
+		for (int attempt{}; attempt < 50 && !connection.IsValid(); ++attempt)
+		{
+			connection = Socket::Connect(host, static_cast<uint16_t>(port));
+			if (!connection.IsValid())
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		if (!connection.IsValid())
+		{
+			std::cout << "Tile worker cannot connect to " << address << "\n";
+			return 1;
+		}
+
+		std::vector<uint8_t> message{};
+		AppendMessage(message, MessageType::Hello, HelloMessage{ PROTOCOL_VERSION, pRenderer->GetTileCount() });
+		if (!connection.SendAll(message.data(), message.size()))
+			return 1;
+
+		std::vector<uint8_t> body{};
+		std::vector<uint32_t> pixels{};
+		uint32_t sampleIndex{};
+		MessageHeader header{};
+		while (connection.ReceiveAll(&header, sizeof(header)))
+		{
+			if (header.size > MAX_MESSAGE_SIZE)
+				return 1;
+			body.resize(header.size);
+			if (!connection.ReceiveAll(body.data(), body.size()))
+				break;
+
+			if (header.type == MessageType::Frame && body.size() == sizeof(FrameMessage))
+			{
+				//Same state the coordinator rendered from, the scene animates from the timer
+				FrameMessage frame{};
+				memcpy(&frame, body.data(), sizeof(frame));
+				Camera& camera{ pScene->GetCamera() };
+				camera.origin = frame.cameraOrigin;
+				camera.totalPitch = frame.cameraPitch;
+				camera.totalYaw = frame.cameraYaw;
+				camera.UpdateFOV(frame.cameraFovAngle);
+				Renderer::ApplySettings(frame.settings);
+				pTimer->SetTime(frame.totalTime, frame.elapsedTime);
+				pScene->Update(pTimer);
+				sampleIndex = frame.sampleIndex;
+			}
+			else if (header.type == MessageType::Job && body.size() >= sizeof(JobMessage))
+			{
+				JobMessage job{};
+				memcpy(&job, body.data(), sizeof(job));
+				const uint32_t tileCount{ pRenderer->GetTileCount() };
+				if (job.tileCount > tileCount || body.size() != sizeof(job) + size_t(job.tileCount) * sizeof(uint32_t))
+					return 1;
+				const std::span<const uint32_t> tiles{ reinterpret_cast<const uint32_t*>(body.data() + sizeof(job)), job.tileCount };
+				//Tile indices address the window's pixels, a corrupt job must not write past them
+				if (std::any_of(tiles.begin(), tiles.end(), [tileCount](uint32_t tileIndex) { return tileIndex >= tileCount; }))
+					return 1;
+				pRenderer->RenderTiles(pScene, tiles, sampleIndex);
+
+				const uint32_t wordCount{ Renderer::GetTileWordCount() };
+				pixels.resize(size_t(job.tileCount) * wordCount);
+				for (uint32_t tile{}; tile < job.tileCount; ++tile)
+					pRenderer->ReadTile(tiles[tile], { pixels.data() + tile * wordCount, wordCount });
+
+				message.clear();
+				AppendMessage(message, MessageType::Result, ResultMessage{ job.frameNumber, job.jobIndex, job.tileCount },
+					pixels.data(), pixels.size() * sizeof(uint32_t));
+				if (!connection.SendAll(message.data(), message.size()))
+					break;
+			}
+			else return 1;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Socket.h"
+
+namespace dae
+{
+	class Scene;
+	class Renderer;
+	class Timer;
+
+	//Renders frames together with worker processes that run the same scene. Every frame is split into jobs of a few tiles,
+	//idle workers pull the next job so faster ones get more of them. Jobs of workers that disconnect are handed out again,
+	//jobs that take much longer than usual are duplicated to an idle worker and the first result is kept
+	class TileCoordinator final
+	{
+	public:
+		//Workers are trusted to run the same build, only local ones can connect unless isLocalOnly is false
+		TileCoordinator(uint16_t port, bool isLocalOnly);
+		~TileCoordinator() = default;
+
+		TileCoordinator(const TileCoordinator&) = delete;
+		TileCoordinator(TileCoordinator&&) noexcept = delete;
+		TileCoordinator& operator=(const TileCoordinator&) = delete;
+		TileCoordinator& operator=(TileCoordinator&&) noexcept = delete;
+
+		bool IsListening() const { return m_Listener.IsValid(); }
+		size_t GetWorkerCount() const { return m_Workers.size(); }
+		//Blocks until workerCount workers said hello or timeoutSeconds passed
+		void WaitForWorkers(size_t workerCount, float timeoutSeconds, Renderer* pRenderer);
+
+		//Renders the current state of the scene through the workers and presents it. Whatever no worker
+		//delivers, because there are none left, is rendered locally
+		void RenderFrame(Scene* pScene, const Timer* pTimer, Renderer* pRenderer);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr uint32_t JOB_TILE_COUNT{ 8 };
+		static constexpr size_t MAX_JOBS_IN_FLIGHT{ 2 }; //Per worker, hides the round trip
+		//A job counts as straggling once it runs this many times longer than the average job
+		static constexpr float STRAGGLER_FACTOR{ 4.f };
+		static constexpr float MIN_STRAGGLER_SECONDS{ 0.05f };
+		//A worker that has not answered for this long counts as dead
+		static constexpr float WORKER_TIMEOUT_SECONDS{ 30.f };
+
+		struct Job
+		{
+			uint32_t firstTile{}; //Offset into the renderer's tile order
+			uint32_t tileCount{};
+			Clock::time_point dispatchTime{};
+			uint32_t dispatchCount{};
+			bool isDone{};
+		};
+
+		struct JobTicket
+		{
+			uint32_t frameNumber{};
+			uint32_t jobIndex{};
+			Clock::time_point dispatchTime{};
+		};
+
+		struct WorkerConnection
+		{
+			Socket socket{};
+			std::vector<uint8_t> received{};
+			//Sent but not answered, can include jobs of earlier frames. A worker only gets new jobs once it caught up
+			std::vector<JobTicket> jobsInFlight{};
+			bool hasSaidHello{};
+		};
+
+		Socket m_Listener{};
+		std::vector<WorkerConnection> m_Workers{};
+		std::vector<Job> m_Jobs{};
+		std::deque<uint32_t> m_PendingJobs{};
+		std::vector<uint8_t> m_FrameMessage{};
+		uint32_t m_FrameNumber{};
+		uint32_t m_DoneJobCount{};
+		float m_AverageJobSeconds{};
+
+		void AcceptWorkers();
+		//False when the worker has to be dropped
+		bool ReceiveMessages(WorkerConnection& worker, Renderer* pRenderer);
+		bool SendJob(WorkerConnection& worker, uint32_t jobIndex, std::span<const uint32_t> tileOrder);
+		void DispatchJobs(std::span<const uint32_t> tileOrder);
+		void DropWorker(size_t workerIndex);
+	};
+
+	//Connects to a coordinator at host:port and renders the tiles it asks for until it disconnects. Returns the process exit code
+	int RunTileWorker(const std::string& address, Scene* pScene, Renderer* pRenderer, Timer* pTimer);
+}
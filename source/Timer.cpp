@@ -4,6 +4,7 @@
 #include <numeric>
 
 #include <iostream>
+#include <filesystem>
 #include <fstream>
 
 #include "SDL.h"
@@ -125,7 +126,17 @@ void Timer::Update()
 				fileStream << "HIGH = " << m_BenchmarkHigh << std::endl;
 				fileStream << "LOW = " << m_BenchmarkLow << std::endl;
 				fileStream << "AVG = " << m_BenchmarkAvg << std::endl;
+				if (!m_BenchmarkLabel.empty()) fileStream << "LABEL = " << m_BenchmarkLabel << std::endl;
 				fileStream.close();
+
+				//One row per run, so frame time can be plotted against the scene configuration
+				std::error_code error{};
+				const bool isNewFile{ std::filesystem::file_size("benchmark.csv", error) == 0 || error };
+				std::ofstream csvStream("benchmark.csv", std::ios::app);
+				if (isNewFile)
+					csvStream << m_BenchmarkColumnNames << (m_BenchmarkColumnNames.empty() ? "" : ",") << "high_fps,low_fps,avg_fps,avg_ms" << std::endl;
+				csvStream << m_BenchmarkColumns << (m_BenchmarkColumns.empty() ? "" : ",") << m_BenchmarkHigh << "," << m_BenchmarkLow << ","
+					<< m_BenchmarkAvg << "," << 1000.f / m_BenchmarkAvg << std::endl;
 			}
 		}
 	}
@@ -2,6 +2,7 @@
 
 //Standard includes
 #include <cstdint>
+#include <string>
 #include <vector>
 
 namespace dae
@@ -18,6 +19,13 @@ namespace dae
 		Timer& operator=(Timer&&) noexcept = delete;
 
 		void StartBenchmark(int numFrames = 10);
+		//Describes the benchmarked configuration in benchmark.txt
+		void SetBenchmarkLabel(const std::string& label) { m_BenchmarkLabel = label; }
+		//Comma separated configuration in front of the times of every benchmark.csv row, names heads a new file
+		void SetBenchmarkColumns(const std::string& names, const std::string& values) { m_BenchmarkColumnNames = names; m_BenchmarkColumns = values; }
+		bool IsBenchmarkActive() const { return m_BenchmarkActive; }
+		//Replaces the measured times, for a process rendering frames that another process timed
+		void SetTime(float totalTime, float elapsedTime) { m_TotalTime = totalTime; m_ElapsedTime = elapsedTime; }
 
 		void Reset();
 		void Start();
@@ -57,5 +65,8 @@ namespace dae
 		int m_BenchmarkFrames{ 0 };
 		int m_BenchmarkCurrFrame{ 0 };
 		std::vector<float> m_Benchmarks{};
+		std::string m_BenchmarkLabel{};
+		std::string m_BenchmarkColumnNames{};
+		std::string m_BenchmarkColumns{};
 	};
 }
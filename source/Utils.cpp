@@ -0,0 +1,210 @@
+#include "Utils.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "TextParsing.h"
+
+#include <algorithm>
+#include <execution>
+#include <thread>
+
+namespace dae
+{
+	using namespace TextParsing;
+
+	namespace
+	{
+		//Chunks smaller than this are not worth a separate task
+		constexpr size_t MIN_OBJ_CHUNK_SIZE{ 1 << 20 };
+
+		struct OBJChunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+
+			std::vector<Vector3> positions{};
+			std::vector<int> indices{};
+			//Slots in indices that came from negative OBJ indices, these are relative to the first vertex of the chunk
+			std::vector<uint32_t> relativeSlots{};
+			bool isValid{ true };
+		};
+
+		//Parses one face corner (v, v/vt, v//vn or v/vt/vn) and returns the position index, 0 if there is none
+		inline const char* ParseFaceCorner(const char* pCurr, const char* pEnd, int& positionIndex)
+		{
+			positionIndex = 0;
+			if (pCurr < pEnd && *pCurr == '+') ++pCurr;
+			const auto [pNext, errorCode] = std::from_chars(pCurr, pEnd, positionIndex);
+			if (errorCode != std::errc{}) positionIndex = 0;
+
+			//Texture coordinate and normal indices are not used by TriangleMesh
+			pCurr = pNext;
+			while (pCurr < pEnd && !IsBlank(*pCurr) && *pCurr != '\n') ++pCurr;
+			return pCurr;
+		}
+
+		void ParseOBJChunk(OBJChunk& chunk)
+		{
+			//Rough upper bounds, a vertex line is rarely shorter than 24 bytes and a face line than 12
+			const size_t chunkSize{ static_cast<size_t>(chunk.pEnd - chunk.pBegin) };
+			chunk.positions.reserve(chunkSize / 24);
+			chunk.indices.reserve(chunkSize / 12 * 3);
+
+			std::vector<int> faceCorners{};
+			faceCorners.reserve(16);
+
+			const char* pCurr{ chunk.pBegin };
+			const char* const pEnd{ chunk.pEnd };
+			while (pCurr < pEnd)
+			{
+				pCurr = SkipBlanks(pCurr, pEnd);
+				if (pCurr + 1 >= pEnd)
+					break;
+
+				if (pCurr[0] == 'v' && IsBlank(pCurr[1]))
+				{
+					Vector3 position{};
+					pCurr = ParseFloat(pCurr + 2, pEnd, position.x);
+					pCurr = ParseFloat(pCurr, pEnd, position.y);
+					pCurr = ParseFloat(pCurr, pEnd, position.z);
+					chunk.positions.emplace_back(position);
+				}
+				else if (pCurr[0] == 'f' && IsBlank(pCurr[1]))
+				{
+					faceCorners.clear();
+					pCurr += 2;
+					while (true)
+					{
+						pCurr = SkipBlanks(pCurr, pEnd);
+						if (pCurr >= pEnd || *pCurr == '\n' || *pCurr == '#')
+							break;
+
+						int positionIndex{};
+						pCurr = ParseFaceCorner(pCurr, pEnd, positionIndex);
+						if (positionIndex == 0)
+						{
+							chunk.isValid = false;
+							return;
+						}
+						faceCorners.push_back(positionIndex);
+					}
+
+					if (faceCorners.size() < 3)
+					{
+						chunk.isValid = false;
+						return;
+					}
+
+					//Fan triangulation (v0, vi, vi+1), negative indices are relative to the vertices read so far
+					const int localVertexCount{ static_cast<int>(chunk.positions.size()) };
+					for (size_t cornerIndex = 1; cornerIndex + 1 < faceCorners.size(); ++cornerIndex)
+					{
+						for (const int corner : { faceCorners[0], faceCorners[cornerIndex], faceCorners[cornerIndex + 1] })
+						{
+							if (corner < 0)
+							{
+								chunk.relativeSlots.push_back(static_cast<uint32_t>(chunk.indices.size()));
+								chunk.indices.push_back(localVertexCount + corner);
+							}
+							else chunk.indices.push_back(corner - 1);
+						}
+					}
+				}
+				//Comments, vt, vn, groups, materials, ... are skipped
+				pCurr = SkipLine(pCurr, pEnd);
+			}
+		}
+	}
+
+	bool Utils::ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<int>& indices)
+	{
+		const MappedFile file{ filename };
+		if (!file.IsOpen())
+			return false;
+
+		const char* const pData{ file.GetData() };
+		const size_t fileSize{ file.GetSize() };
+		if (fileSize == 0)
+			return true;
+
+		//Split the file in chunks that end on a line break
+		const size_t maxChunks{ std::max<size_t>(1, std::thread::hardware_concurrency() * 4) };
+		const size_t chunkCount{ std::clamp<size_t>(fileSize / MIN_OBJ_CHUNK_SIZE, 1, maxChunks) };
+		const size_t targetChunkSize{ fileSize / chunkCount };
+
+		std::vector<OBJChunk> chunks(chunkCount);
+		const char* pChunkBegin{ pData };
+		const char* const pFileEnd{ pData + fileSize };
+		for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+		{
+			const char* pChunkEnd{ pFileEnd };
+			if (chunkIndex + 1 < chunkCount)
+			{
+				pChunkEnd = std::min(pChunkBegin + targetChunkSize, pFileEnd);
+				pChunkEnd = SkipLine(pChunkEnd, pFileEnd);
+			}
+			chunks[chunkIndex].pBegin = pChunkBegin;
+			chunks[chunkIndex].pEnd = pChunkEnd;
+			pChunkBegin = pChunkEnd;
+		}
+
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [](OBJChunk& chunk)
+			{
+				if (chunk.pBegin < chunk.pEnd) ParseOBJChunk(chunk);
+			});
+
+		size_t totalPositions{}, totalIndices{};
+		for (const OBJChunk& chunk : chunks)
+		{
+			if (!chunk.isValid)
+				return false;
+			totalPositions += chunk.positions.size();
+			totalIndices += chunk.indices.size();
+		}
+
+		//Resolve chunk local indices to mesh indices while merging
+		const int firstVertex{ static_cast<int>(positions.size()) };
+		positions.reserve(positions.size() + totalPositions);
+		indices.reserve(indices.size() + totalIndices);
+
+		int chunkFirstVertex{ firstVertex };
+		for (OBJChunk& chunk : chunks)
+		{
+			for (const uint32_t slot : chunk.relativeSlots)
+			{
+				chunk.indices[slot] += chunkFirstVertex - firstVertex;
+			}
+
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			for (const int index : chunk.indices)
+			{
+				indices.push_back(firstVertex + index);
+			}
+			chunkFirstVertex += static_cast<int>(chunk.positions.size());
+		}
+
+		//Out of range indices would crash the hit tests later on
+		const int vertexCount{ static_cast<int>(positions.size()) };
+		return std::all_of(indices.end() - totalIndices, indices.end(),
+			[firstVertex, vertexCount](int index) { return index >= firstVertex && index < vertexCount; });
+	}
+
+	bool Utils::LoadMesh(const std::string& filename, TriangleMesh& mesh)
+	{
+		if (MeshCache::Load(filename, mesh))
+			return true;
+
+		std::vector<Vector3> positions{};
+		std::vector<int> indices{};
+		if (!ParseOBJ(filename, positions, indices))
+			return false;
+
+		mesh.positions = std::move(positions);
+		mesh.indices = std::move(indices);
+		mesh.UpdateAABB();
+		mesh.BuildBVH();
+
+		//A failed write only costs the next startup a reparse
+		MeshCache::Write(filename, mesh);
+		return true;
+	}
+}
@@ -1,6 +1,8 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <string>
+#include <vector>
 #include "Math.h"
 #include "DataTypes.h"
 
@@ -41,10 +43,18 @@ namespace dae
 			return true;
 		}
 
+		//Any-hit test for shadow rays, nothing but the range check is computed
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Sphere(sphere, ray, temp, true);
+			const Vector3 rayToSphere{ sphere.origin - ray.origin };
+			const float tCa{ Vector3::Dot(rayToSphere, ray.direction) };
+
+			const float od{ rayToSphere.SqrMagnitude() - tCa * tCa };
+			if (od >= sphere.radiusSqrt) return false;
+
+			const float tHc{ sqrt(sphere.radiusSqrt - od) };
+			const float tZero{ (tCa - tHc > ray.min) ? tCa - tHc : tCa + tHc };
+			return tZero >= ray.min && tZero <= ray.max;
 		}
 #pragma endregion
 #pragma region Plane HitTest
@@ -71,8 +81,8 @@ namespace dae
 
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Plane(plane, ray, temp, true);
+			const float t{ Vector3::Dot(plane.origin - ray.origin,plane.normal) / Vector3::Dot(ray.direction,plane.normal) };
+			return t >= ray.min && t <= ray.max;
 		}
 #pragma endregion
 #pragma region Triangle HitTest
@@ -172,10 +182,40 @@ namespace dae
 #endif
 		}
 
-		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray)
+		//Any-hit test for shadow rays straight from mesh vertices, uses the shadow side of the cull mode like the ignoreHitRecord path
+		inline bool HitTest_Triangle(const Vector3& v0, const Vector3& v1, const Vector3& v2, TriangleCullMode cullMode, const Ray& ray)
 		{
+#ifdef MOLLER_TRUMBORE
+			const Vector3 edge1{ v1 - v0 };
+			const Vector3 edge2{ v2 - v0 };
+			const Vector3 h{ Vector3::Cross(ray.direction,edge2) };
+			const float a{ Vector3::Dot(edge1,h) };
+
+			if (cullMode == TriangleCullMode::FrontFaceCulling && a < FLT_EPSILON) return false;
+			if (cullMode == TriangleCullMode::NoCulling && a > FLT_EPSILON) return false;
+
+			const float f{ 1.f / a };
+			const Vector3 s{ ray.origin - v0 };
+			const float u{ f * Vector3::Dot(s,h) };
+			if (u < 0.f || u > 1.f) return false;
+
+			const Vector3 q{ Vector3::Cross(s,edge1) };
+			const float v{ f * Vector3::Dot(ray.direction,q) };
+			if (v < 0.f || u + v > 1.f) return false;
+
+			const float t{ f * Vector3::Dot(edge2, q) };
+			return t >= ray.min && t <= ray.max;
+#else
+			Triangle triangle{ v0, v1, v2 };
+			triangle.cullMode = cullMode;
 			HitRecord temp{};
 			return HitTest_Triangle(triangle, ray, temp, true);
+#endif
+		}
+
+		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray)
+		{
+			return HitTest_Triangle(triangle.v0, triangle.v1, triangle.v2, triangle.cullMode, ray);
 		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
@@ -204,34 +244,114 @@ namespace dae
 
 			return tmax > 0 && tmax >= tmin;
 		}
+		//Slab test that also returns the entry distance, used to visit the nearest child first
+		inline bool AABB_Slab(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& invDirection, float& tNear)
+		{
+			const float tx1 = (minAABB.x - ray.origin.x) * invDirection.x;
+			const float tx2 = (maxAABB.x - ray.origin.x) * invDirection.x;
+			float tmin = std::min(tx1, tx2);
+			float tmax = std::max(tx1, tx2);
+
+			const float ty1 = (minAABB.y - ray.origin.y) * invDirection.y;
+			const float ty2 = (maxAABB.y - ray.origin.y) * invDirection.y;
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1 = (minAABB.z - ray.origin.z) * invDirection.z;
+			const float tz2 = (maxAABB.z - ray.origin.z) * invDirection.z;
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			tNear = tmin;
+			return tmax > 0 && tmax >= tmin && tmin <= ray.max;
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
 			//todo W5
 			//assert(false && "No Implemented Yet!");
 			if (!AABB_TriangleMesh(mesh, ray)) return false;
 
+			//Closer hits shrink the ray so the hierarchy can skip everything behind them
+			Ray boundedRay{ ray };
+			if (!ignoreHitRecord) boundedRay.max = std::min(ray.max, hitRecord.t);
+
 			Triangle triangle {};
-			Vector3 vertA, vertB, vertC;
 			HitRecord tempHit{};
-			
-			for (int i = 0; i < mesh.indices.size(); i+=3)
+			bool didHitMesh{ false };
+
+			//Returns true when the search can stop
+			const auto testTriangles = [&](uint32_t firstIndex, uint32_t lastIndex)
 			{
-				vertA = mesh.transformedPositions[mesh.indices[i ]];
-				vertB = mesh.transformedPositions[mesh.indices[i + 1]];
-				vertC = mesh.transformedPositions[mesh.indices[i + 2]];
-				triangle = Triangle{ vertA,vertB,vertC };
-				//triangle.normal = mesh.transformedNormals[i];
-				triangle.cullMode = mesh.cullMode;
-				if (!ignoreHitRecord)
+				for (uint32_t i = firstIndex; i < lastIndex; i += 3)
 				{
-					if (HitTest_Triangle(triangle, ray, tempHit) && tempHit.t < hitRecord.t) hitRecord = tempHit;
+					triangle = Triangle{ mesh.transformedPositions[mesh.indices[i]],
+						mesh.transformedPositions[mesh.indices[i + 1]],
+						mesh.transformedPositions[mesh.indices[i + 2]] };
+					triangle.cullMode = mesh.cullMode;
+					if (!ignoreHitRecord)
+					{
+						if (HitTest_Triangle(triangle, boundedRay, tempHit))
+						{
+							hitRecord = tempHit;
+							boundedRay.max = tempHit.t;
+							didHitMesh = true;
+						}
+					}
+					else if (HitTest_Triangle(triangle, boundedRay)) return true;
 				}
-				else
+				return false;
+			};
+
+			if (mesh.transformedBVHNodes.empty())
+			{
+				if (testTriangles(0, static_cast<uint32_t>(mesh.indices.size()))) return true;
+			}
+			else
+			{
+				const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+				const std::vector<BVHNode>& nodes{ mesh.transformedBVHNodes };
+
+				uint32_t stack[BVH::MAX_DEPTH];
+				int stackSize{ 0 };
+				uint32_t nodeIndex{ 0 };
+				float tNear{};
+				if (!AABB_Slab(nodes[0].minAABB, nodes[0].maxAABB, boundedRay, invDirection, tNear)) return false;
+
+				while (true)
 				{
-					if (HitTest_Triangle(triangle, ray)) return true;
+					const BVHNode& node{ nodes[nodeIndex] };
+					if (node.IsLeaf())
+					{
+						if (testTriangles(node.leftFirst * 3, (node.leftFirst + node.triangleCount) * 3)) return true;
+					}
+					else
+					{
+						float tLeft{}, tRight{};
+						const uint32_t leftIndex{ node.leftFirst };
+						const bool hitLeft{ AABB_Slab(nodes[leftIndex].minAABB, nodes[leftIndex].maxAABB, boundedRay, invDirection, tLeft) };
+						const bool hitRight{ AABB_Slab(nodes[leftIndex + 1].minAABB, nodes[leftIndex + 1].maxAABB, boundedRay, invDirection, tRight) };
+
+						if (hitLeft && hitRight)
+						{
+							const bool leftFirst{ tLeft <= tRight };
+							stack[stackSize++] = leftFirst ? leftIndex + 1 : leftIndex;
+							nodeIndex = leftFirst ? leftIndex : leftIndex + 1;
+							continue;
+						}
+						if (hitLeft || hitRight)
+						{
+							nodeIndex = hitLeft ? leftIndex : leftIndex + 1;
+							continue;
+						}
+					}
+
+					if (stackSize == 0) break;
+					nodeIndex = stack[--stackSize];
 				}
 			}
-			if (hitRecord.didHit) 
+
+			if (didHitMesh)
 			{
 				hitRecord.materialIndex = mesh.materialIndex;
 				return true;
@@ -239,34 +359,111 @@ namespace dae
 			return false;
 		}
 
+		//Any-hit test of one mesh triangle, firstIndex is the position of its first vertex index in mesh.indices
+		inline bool HitTest_MeshTriangle(const TriangleMesh& mesh, uint32_t firstIndex, const Ray& ray)
+		{
+			return HitTest_Triangle(mesh.transformedPositions[mesh.indices[firstIndex]],
+				mesh.transformedPositions[mesh.indices[firstIndex + 1]],
+				mesh.transformedPositions[mesh.indices[firstIndex + 2]], mesh.cullMode, ray);
+		}
+
+		/**
+		 * \brief Any-hit traversal for shadow rays, stops at the first blocking triangle
+		 * \param occluderIndex first index (in mesh.indices) of the blocking triangle
+		 */
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, uint32_t& occluderIndex)
+		{
+			if (!AABB_TriangleMesh(mesh, ray)) return false;
+
+			const std::vector<BVHNode>& nodes{ mesh.transformedBVHNodes };
+			if (nodes.empty())
+			{
+				for (uint32_t i = 0; i < static_cast<uint32_t>(mesh.indices.size()); i += 3)
+				{
+					if (!HitTest_MeshTriangle(mesh, i, ray)) continue;
+					occluderIndex = i;
+					return true;
+				}
+				return false;
+			}
+
+			//Any blocker will do, so there is no need to visit the children in order
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+			uint32_t stack[BVH::MAX_DEPTH + 1];
+			int stackSize{ 0 };
+			stack[stackSize++] = 0;
+			while (stackSize > 0)
+			{
+				const BVHNode& node{ nodes[stack[--stackSize]] };
+				float tNear{};
+				if (!AABB_Slab(node.minAABB, node.maxAABB, ray, invDirection, tNear)) continue;
+
+				if (!node.IsLeaf())
+				{
+					stack[stackSize++] = node.leftFirst;
+					stack[stackSize++] = node.leftFirst + 1;
+					continue;
+				}
+
+				for (uint32_t i = node.leftFirst * 3; i < (node.leftFirst + node.triangleCount) * 3; i += 3)
+				{
+					if (!HitTest_MeshTriangle(mesh, i, ray)) continue;
+					occluderIndex = i;
+					return true;
+				}
+			}
+			return false;
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_TriangleMesh(mesh, ray, temp, true);
+			uint32_t occluderIndex{};
+			return HitTest_TriangleMesh(mesh, ray, occluderIndex);
 		}
 #pragma endregion
 	}
 
 	namespace LightUtils
 	{
+		//Distance used for directional lights, far enough to be "infinite" while its square still fits in a float
+		constexpr float DIRECTIONAL_LIGHT_DISTANCE{ 1e10f };
+
 		//Direction from target to light
 		inline Vector3 GetDirectionToLight(const Light& light, const Vector3& origin)
 		{
 			//todo W3
 			//assert(false && "No Implemented Yet!");
-			if (light.type == LightType::Point) return Vector3{ light.origin - origin };
-			else return { light.direction * FLT_MAX };
+			//Area lights are approximated by their centre
+			if (light.type != LightType::Directional) return Vector3{ light.origin - origin };
+			//FLT_MAX would overflow when the caller normalizes the result
+			else return { light.direction * DIRECTIONAL_LIGHT_DISTANCE };
+		}
+
+		//Distance at which the unwindowed inverse square falloff of a point light drops below threshold
+		inline float GetInfluenceRadius(const Light& light, float threshold)
+		{
+			const float maxChannel{ std::max(light.color.r, std::max(light.color.g, light.color.b)) };
+			return sqrtf(light.intensity * maxChannel / threshold);
 		}
 
 		inline ColorRGB GetRadiance(const Light& light, const Vector3& target)
 		{
 			//todo W3
 			//assert(false && "No Implemented Yet!");
-			if(light.type == LightType::Point)
+			if(light.type != LightType::Directional)
 			{
 				Vector3 dist{ target - light.origin };
+				const float sqrDistance{ dist.SqrMagnitude() };
+				float falloff{ light.intensity / sqrDistance };
+				if (light.influenceRadius > 0.f)
+				{
+					//Window (1 - (d/r)^4)^2 takes the light smoothly to zero at its influence radius
+					const float ratio{ sqrDistance / Square(light.influenceRadius) };
+					if (ratio >= 1.f) return {};
+					falloff *= Square(1.f - ratio * ratio);
+				}
 				//irradiance
-				const ColorRGB Ergb{ light.color * (light.intensity / dist.SqrMagnitude()) };
+				const ColorRGB Ergb{ light.color * falloff };
 				return Ergb;
 			}
 			else
@@ -276,80 +473,189 @@ namespace dae
 			}
 		}
 
-	}
+		inline bool IsAreaLight(const Light& light)
+		{
+			return light.type == LightType::Sphere || light.type == LightType::Quad;
+		}
 
-	namespace Utils
-	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions,/* std::vector<Vector3>& normals,*/ std::vector<int>& indices)
+		//Half the size of the box around a light along every axis, 0 for point lights
+		inline Vector3 GetHalfExtent(const Light& light)
 		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
+			switch (light.type)
+			{
+			case LightType::Sphere:
+				return { light.radius, light.radius, light.radius };
+			case LightType::Quad:
+				return 0.5f * Vector3{ fabsf(light.edgeX.x) + fabsf(light.edgeY.x), fabsf(light.edgeX.y) + fabsf(light.edgeY.y),
+					fabsf(light.edgeX.z) + fabsf(light.edgeY.z) };
+			default:
+				return {};
+			}
+		}
+
+		//Angle between two unit vectors, accurate for small angles as well
+		inline float AngleBetween(const Vector3& v1, const Vector3& v2)
+		{
+			if (Vector3::Dot(v1, v2) < 0.f)
+				return PI - 2.f * asinf(std::min(1.f, (v1 + v2).Magnitude() * 0.5f));
+			return 2.f * asinf(std::min(1.f, (v2 - v1).Magnitude() * 0.5f));
+		}
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
+		//Samples an area light from one point with a density that is uniform over the solid angle it covers. Everything
+		//that only depends on the point is set up once, so taking many samples of the same light stays cheap.
+		//Spheres sample the cone around them, quads are sampled as spherical rectangles (Urena et al. 2013)
+		class AreaLightSampler final
+		{
+		public:
+			//False if target is inside the sphere or behind the quad
+			bool Begin(const Light& light, const Vector3& target)
 			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
+				m_Type = light.type;
+				if (light.type == LightType::Sphere)
 				{
-					// Ignore Comment
+					const Vector3 toCenter{ light.origin - target };
+					m_CenterSqrDistance = toCenter.SqrMagnitude();
+					m_RadiusSqr = Square(light.radius);
+					if (m_CenterSqrDistance <= m_RadiusSqr) return false;
+					m_CenterDistance = sqrtf(m_CenterSqrDistance);
+					m_AxisZ = toCenter / m_CenterDistance;
+					m_AxisX = (fabsf(m_AxisZ.x) > 0.9f ? Vector3::Cross(m_AxisZ, Vector3::UnitY) : Vector3::Cross(m_AxisZ, Vector3::UnitX)).Normalized();
+					m_AxisY = Vector3::Cross(m_AxisZ, m_AxisX);
+
+					//1 - cos written so it keeps its precision for small, distant spheres
+					const float sinThetaMaxSqr{ m_RadiusSqr / m_CenterSqrDistance };
+					m_OneMinusCosThetaMax = sinThetaMaxSqr / (1.f + sqrtf(1.f - sinThetaMaxSqr));
+					const float solidAngle{ PI_2 * m_OneMinusCosThetaMax };
+					m_Radiance = light.color * (light.intensity / (PI * m_RadiusSqr) * solidAngle);
+					return true;
 				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
 
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof())
-					break;
+				//Quads only emit on the side of their normal
+				const Vector3 corner{ light.origin - 0.5f * light.edgeX - 0.5f * light.edgeY };
+				m_ToCorner = corner - target;
+				if (Vector3::Dot(m_ToCorner, light.direction) >= 0.f) return false;
+
+				const float lengthX{ light.edgeX.Magnitude() }, lengthY{ light.edgeY.Magnitude() };
+				m_EdgeX = light.edgeX;
+				m_EdgeY = light.edgeY;
+				m_Normal = light.direction;
+				m_Area = lengthX * lengthY;
+				m_Radiance = light.color * (light.intensity / m_Area);
+
+				//Local frame with the quad in the plane z = z0 < 0, corners at x0..x1 and y0..y1
+				m_AxisX = light.edgeX / lengthX;
+				m_AxisY = light.edgeY / lengthY;
+				m_AxisZ = light.direction;
+				m_X0 = Vector3::Dot(m_ToCorner, m_AxisX);
+				m_Y0 = Vector3::Dot(m_ToCorner, m_AxisY);
+				m_Z0 = Vector3::Dot(m_ToCorner, m_AxisZ);
+				m_X1 = m_X0 + lengthX;
+				m_Y1 = m_Y0 + lengthY;
+
+				//Normals of the planes through target and the edges, the solid angle is the spherical excess of their angles
+				const Vector3 v00{ m_X0, m_Y0, m_Z0 }, v01{ m_X0, m_Y1, m_Z0 }, v10{ m_X1, m_Y0, m_Z0 }, v11{ m_X1, m_Y1, m_Z0 };
+				const Vector3 n0{ Vector3::Cross(v00, v10).Normalized() };
+				const Vector3 n1{ Vector3::Cross(v10, v11).Normalized() };
+				const Vector3 n2{ Vector3::Cross(v11, v01).Normalized() };
+				const Vector3 n3{ Vector3::Cross(v01, v00).Normalized() };
+				const float g0{ AngleBetween(-n0, n1) }, g1{ AngleBetween(-n1, n2) };
+				const float g2{ AngleBetween(-n2, n3) }, g3{ AngleBetween(-n3, n0) };
+				m_SolidAngle = g0 + g1 + g2 + g3 - PI_2;
+				m_B0 = n0.z;
+				m_B1 = n2.z;
+				m_G2G3 = g2 + g3;
+				return true;
 			}
 
-			//Precompute normals
-			/*for (uint64_t index = 0; index < indices.size(); index += 3)
+			/**
+			 * \param u, v uniform random numbers in [0, 1), stratifying them stratifies the directions
+			 * \param direction unit direction from target to the sampled point
+			 * \param distance distance from target to the sampled point
+			 * \param radiance radiance arriving from direction divided by the density of picking it
+			 */
+			void Sample(float u, float v, Vector3& direction, float& distance, ColorRGB& radiance) const
 			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if (isnan(normal.x))
+				if (m_Type == LightType::Sphere)
 				{
-					int k = 0;
+					const float cosTheta{ 1.f - u * m_OneMinusCosThetaMax };
+					const float sinThetaSqr{ u * m_OneMinusCosThetaMax * (1.f + cosTheta) };
+					const float sinTheta{ sqrtf(sinThetaSqr) };
+					const float phi{ PI_2 * v };
+					direction = m_AxisX * (cosf(phi) * sinTheta) + m_AxisY * (sinf(phi) * sinTheta) + m_AxisZ * cosTheta;
+					//Nearest of the two intersections of the sampled ray with the sphere
+					distance = m_CenterDistance * cosTheta - sqrtf(std::max(0.f, m_RadiusSqr - m_CenterSqrDistance * sinThetaSqr));
+					radiance = m_Radiance;
+					return;
 				}
 
-				normal.Normalize();
-				if (isnan(normal.x))
+				//Seen from far away the spherical rectangle loses its precision, a uniform point on the quad is as good there
+				if (m_SolidAngle < 1e-3f)
 				{
-					int k = 0;
+					const Vector3 toPoint{ m_ToCorner + u * m_EdgeX + v * m_EdgeY };
+					const float sqrDistance{ toPoint.SqrMagnitude() };
+					distance = sqrtf(sqrDistance);
+					direction = toPoint / distance;
+					const float cosLight{ -Vector3::Dot(direction, m_Normal) };
+					radiance = m_Radiance * (m_Area * cosLight / sqrDistance);
+					return;
 				}
 
-				normals.push_back(normal);
-			}*/
+				//Invert the solid angle covered up to u to find the x of the sample
+				const float au{ u * m_SolidAngle - m_G2G3 };
+				const float fu{ (cosf(au) * m_B0 - m_B1) / sinf(au) };
+				const float cu{ std::clamp(std::copysign(1.f, fu) / sqrtf(Square(fu) + Square(m_B0)), -0.99999994f, 0.99999994f) };
+				const float xu{ std::clamp(-(cu * m_Z0) / std::max(sqrtf(1.f - Square(cu)), 1e-7f), m_X0, m_X1) };
+
+				//Then its y, uniform in the height of the rectangle's column as seen from target
+				const float d{ sqrtf(Square(xu) + Square(m_Z0)) };
+				const float h0{ m_Y0 / sqrtf(Square(d) + Square(m_Y0)) };
+				const float h1{ m_Y1 / sqrtf(Square(d) + Square(m_Y1)) };
+				const float hv{ h0 + v * (h1 - h0) };
+				const float hvSqr{ Square(hv) };
+				const float yv{ (hvSqr < 1.f - 1e-6f) ? (hv * d) / sqrtf(1.f - hvSqr) : m_Y1 };
+
+				const Vector3 toPoint{ xu * m_AxisX + yv * m_AxisY + m_Z0 * m_AxisZ };
+				distance = toPoint.Magnitude();
+				direction = toPoint / distance;
+				radiance = m_Radiance * m_SolidAngle;
+			}
 
-			return true;
-		}
-#pragma warning(pop)
+		private:
+			LightType m_Type{};
+			//Sphere: axis of the cone in z. Quad: edge directions and normal
+			Vector3 m_AxisX{}, m_AxisY{}, m_AxisZ{};
+			//Emitted radiance, for spheres already divided by the density
+			ColorRGB m_Radiance{};
+
+			float m_CenterDistance{}, m_CenterSqrDistance{}, m_RadiusSqr{}, m_OneMinusCosThetaMax{};
+
+			Vector3 m_ToCorner{}, m_EdgeX{}, m_EdgeY{}, m_Normal{};
+			float m_Area{}, m_SolidAngle{};
+			float m_X0{}, m_X1{}, m_Y0{}, m_Y1{}, m_Z0{};
+			float m_B0{}, m_B1{}, m_G2G3{};
+		};
+	}
+
+	namespace Utils
+	{
+		/**
+		 * \brief Parses the vertices and faces of a Wavefront OBJ file
+		 * The file is memory mapped and parsed in parallel chunks. Faces accept the v, v/vt, v//vn and v/vt/vn
+		 * forms with positive or negative (relative) indices, polygons with more than 3 corners are fan triangulated.
+		 * \param filename path to the .obj file
+		 * \param positions vertex positions, appended to
+		 * \param indices triangle list indices into positions, appended to
+		 * \return false if the file could not be opened or contains an invalid face
+		 */
+		bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<int>& indices);
+
+		/**
+		 * \brief Loads an OBJ file into a mesh, including its bounds and BVH
+		 * Uses the binary cache next to the file when it is up to date, otherwise the OBJ is parsed and the cache rewritten.
+		 * \param filename path to the .obj file
+		 * \param mesh mesh whose geometry is replaced
+		 * \return false if neither the cache nor the OBJ could be loaded
+		 */
+		bool LoadMesh(const std::string& filename, TriangleMesh& mesh);
 	}
 }
\ No newline at end of file
@@ -6,11 +6,16 @@
 
 //Standard includes
 #include <iostream>
+#include <exception>
+#include <string>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "FrameWriter.h"
+#include "TileDistribution.h"
+#include "Checkpoint.h"
 
 using namespace dae;
 
@@ -20,23 +25,280 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+struct Options
+{
+	std::string sceneName{ "W3" };
+	StressSceneSettings stressSettings{};
+	int benchmarkFrames{ 0 }; //Start a benchmark right away and quit when it is done
+	float lightCutoff{ 0.f }; //Radiance at which point lights get culled, 0 keeps them unbounded
+	float shadowCutoff{ 0.f }; //Contribution below which the remaining shadow rays of a pixel are skipped
+	std::string recordPattern{}; //Write every frame from the start, F10 starts and stops recording otherwise
+	int width{ 640 };
+	int height{ 480 };
+	int coordinatorPort{ 0 }; //Hand the tiles of every frame to worker processes connecting to this port
+	bool isListeningOnAllInterfaces{ false }; //Workers on other machines can connect, the coordinator trusts every one of them
+	int workerCount{ 0 }; //Workers the coordinator waits for before the first frame
+	std::string workerAddress{}; //host:port of the coordinator, runs this process as a headless tile worker
+	std::string stillFilename{}; //Render one image at the resolution into this file instead of opening a window
+	std::string checkpointFilename{}; //Accumulate in many lights mode and save the progress here periodically
+	float checkpointInterval{ 60.f };
+	std::string resumeFilename{}; //Continue the accumulation saved in this checkpoint
+	uint32_t sampleCount{ 0 }; //Quit once every pixel accumulated this many frames
+	float frameBudget{ 0.f }; //Milliseconds, starts in deadline mode when set
+	SamplerType samplerType{ SamplerType::Sobol }; //Random sequence of the many lights accumulation
+	int areaLightSamples{ 16 }; //Shadow rays per area light and hit inside a penumbra
+	int bounces{ 0 }; //Reflection and refraction depth, 0 starts with them off
+	uint32_t rayBudget{ 0 }; //Secondary rays per frame before the depth drops, 0 is unlimited
+	Renderer::LightingMode lightMode{ Renderer::LightingMode::Combined };
+	int ambientOcclusionSamples{ 16 }; //Hemisphere rays per hit of ambient occlusion
+	float ambientOcclusionRadius{ 1.f };
+	float ambientRadiance{ 0.f }; //Ambient light the combined mode adds through ambient occlusion, 0 leaves it out
+};
+
+//F10 records here unless --record names something else
+const std::string DEFAULT_RECORD_PATTERN{ "Frames/frame_#####.ppm" };
+
+void PrintUsage()
+{
+	std::cout << "Usage: RayTracer [options]\n"
+		<< "  --scene <W1|W2|W3|W4_Reference|W4_Bunny|Extra|Stress|file.scene>\n"
+		<< "  --benchmark <seconds>      benchmark from the first frame, append to benchmark.csv and quit\n"
+		<< "  --light-cutoff <radiance>  bound point lights where their radiance drops below this value\n"
+		<< "  --shadow-cutoff <radiance> skip the shadow rays of the weakest lights of a pixel adding up to less than this\n"
+		<< "  --record <pattern>         write every frame, '#' is replaced by the frame number and the extension picks\n"
+		<< "                             ppm, bmp, png or raw. '-' streams raw 8 bit RGB frames to stdout\n"
+		<< "  --resolution <width>x<height>\n"
+		<< "  --frame-budget <ms>        stop tracing tiles after this long, F11 toggles it (20 ms by default)\n"
+		<< "  --still <file.ppm>         render a single image at the resolution straight to disk and quit, any size works\n"
+		<< "  --area-light-samples <n>   shadow rays per area light in penumbrae, 4 elsewhere (16 by default)\n"
+		<< "  --bounces <n>              follow reflections and refractions n levels deep (at most 8), B toggles them at 3 otherwise\n"
+		<< "  --light-mode <area|radiance|brdf|combined|path|ao>  F3 cycles through them, path traces global illumination progressively\n"
+		<< "  --ao-samples <n>           ambient occlusion rays per hit, rounded to a square grid (16 by default)\n"
+		<< "  --ao-radius <distance>     length of the ambient occlusion rays (1 by default)\n"
+		<< "  --ambient <radiance>       ambient light the combined mode adds where ambient occlusion lets it through\n"
+		<< "  --ray-budget <n>           secondary rays per frame, the depth drops while frames go over it (unlimited by default)\n"
+		<< "Progressive rendering, accumulates frames in many lights mode:\n"
+		<< "  --checkpoint <file>        save the accumulation to this file periodically and on exit\n"
+		<< "  --checkpoint-interval <seconds>\n"
+		<< "  --resume <file>            continue the accumulation of a checkpoint, saves back to it unless --checkpoint is given\n"
+		<< "  --samples <n>              save a screenshot and quit once every pixel has n samples, stills take n samples per pixel\n"
+		<< "  --sampler <white|sobol|blue>  random sequence of the samples, F12 cycles through them (sobol by default)\n"
+		<< "Distributed rendering, every process gets the same scene options:\n"
+		<< "  --coordinator <port>       render the tiles of each frame on the workers that connect to this port\n"
+		<< "  --workers <n>              wait up to 30 seconds for n workers before the first frame\n"
+		<< "  --listen <local|all>       interfaces the coordinator accepts workers on, only trusted networks for all (local by default)\n"
+		<< "  --worker <host:port>       render tiles for a coordinator without a window\n"
+		<< "Stress scene:\n"
+		<< "  --spheres <n> --meshes <n> --lights <n> --dirlights <n>\n"
+		<< "  --distribution <uniform|clustered|grid> --extent <size> --seed <n> --meshdir <directory>\n";
+}
+
+bool ParseCommandLine(int argc, char* args[], Options& options)
+{
+	for (int argIndex = 1; argIndex < argc; ++argIndex)
+	{
+		const std::string arg{ args[argIndex] };
+		if (argIndex + 1 >= argc)
+			return false;
+		const std::string value{ args[++argIndex] };
+
+		StressSceneSettings& stress{ options.stressSettings };
+		if (arg == "--scene") options.sceneName = value;
+		else if (arg == "--benchmark")
+		{
+			options.benchmarkFrames = std::stoi(value);
+			if (options.benchmarkFrames <= 0) return false;
+		}
+		else if (arg == "--light-cutoff") options.lightCutoff = std::stof(value);
+		else if (arg == "--shadow-cutoff") options.shadowCutoff = std::stof(value);
+		else if (arg == "--record") options.recordPattern = value;
+		else if (arg == "--resolution")
+		{
+			const size_t separator{ value.find('x') };
+			if (separator == std::string::npos) return false;
+			options.width = std::stoi(value.substr(0, separator));
+			options.height = std::stoi(value.substr(separator + 1));
+			if (options.width <= 0 || options.height <= 0) return false;
+		}
+		else if (arg == "--coordinator")
+		{
+			options.coordinatorPort = std::stoi(value);
+			if (options.coordinatorPort <= 0 || options.coordinatorPort > 65535) return false;
+		}
+		else if (arg == "--workers") options.workerCount = std::stoi(value);
+		else if (arg == "--listen")
+		{
+			if (value == "local") options.isListeningOnAllInterfaces = false;
+			else if (value == "all") options.isListeningOnAllInterfaces = true;
+			else return false;
+		}
+		else if (arg == "--worker") options.workerAddress = value;
+		else if (arg == "--still") options.stillFilename = value;
+		else if (arg == "--checkpoint") options.checkpointFilename = value;
+		else if (arg == "--checkpoint-interval") options.checkpointInterval = std::stof(value);
+		else if (arg == "--resume") options.resumeFilename = value;
+		else if (arg == "--samples") options.sampleCount = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--frame-budget") options.frameBudget = std::stof(value);
+		else if (arg == "--area-light-samples") options.areaLightSamples = std::stoi(value);
+		else if (arg == "--bounces") options.bounces = std::stoi(value);
+		else if (arg == "--light-mode")
+		{
+			if (value == "area") options.lightMode = Renderer::LightingMode::ObservedArea;
+			else if (value == "radiance") options.lightMode = Renderer::LightingMode::Radiance;
+			else if (value == "brdf") options.lightMode = Renderer::LightingMode::BRDF;
+			else if (value == "combined") options.lightMode = Renderer::LightingMode::Combined;
+			else if (value == "path") options.lightMode = Renderer::LightingMode::PathTraced;
+			else if (value == "ao") options.lightMode = Renderer::LightingMode::AmbientOcclusion;
+			else return false;
+		}
+		else if (arg == "--ao-samples") options.ambientOcclusionSamples = std::stoi(value);
+		else if (arg == "--ao-radius") options.ambientOcclusionRadius = std::stof(value);
+		else if (arg == "--ambient") options.ambientRadiance = std::stof(value);
+		else if (arg == "--ray-budget") options.rayBudget = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--sampler")
+		{
+			if (value == "white") options.samplerType = SamplerType::WhiteNoise;
+			else if (value == "sobol") options.samplerType = SamplerType::Sobol;
+			else if (value == "blue") options.samplerType = SamplerType::BlueNoise;
+			else return false;
+		}
+		else if (arg == "--spheres") stress.sphereCount = std::stoi(value);
+		else if (arg == "--meshes") stress.meshInstanceCount = std::stoi(value);
+		else if (arg == "--lights") stress.pointLightCount = std::stoi(value);
+		else if (arg == "--dirlights") stress.directionalLightCount = std::stoi(value);
+		else if (arg == "--extent") stress.extent = std::stof(value);
+		else if (arg == "--seed") stress.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--meshdir") stress.meshDirectory = value;
+		else if (arg == "--distribution")
+		{
+			if (value == "uniform") stress.distribution = StressDistribution::Uniform;
+			else if (value == "clustered") stress.distribution = StressDistribution::Clustered;
+			else if (value == "grid") stress.distribution = StressDistribution::Grid;
+			else return false;
+		}
+		else return false;
+	}
+
+	//Negative counts would turn into huge reservations, an empty room has no space to spread the content in
+	const StressSceneSettings& stress{ options.stressSettings };
+	return stress.sphereCount >= 0 && stress.meshInstanceCount >= 0 && stress.pointLightCount >= 0 &&
+		stress.directionalLightCount >= 0 && stress.extent > 0.f;
+}
+
+//Built-in scenes by name, anything else is treated as a scene description file
+Scene* CreateScene(const Options& options)
+{
+	const std::string& sceneName{ options.sceneName };
+	if (sceneName == "W1") return new Scene_W1();
+	if (sceneName == "W2") return new Scene_W2();
+	if (sceneName == "W3") return new Scene_W3();
+	if (sceneName == "W4_Reference") return new Scene_W4_Reference();
+	if (sceneName == "W4_Bunny") return new Scene_W4_Bunny();
+	if (sceneName == "Extra") return new Scene_Extra();
+	if (sceneName == "Stress") return new Scene_Stress(options.stressSettings);
+	return new Scene_File(sceneName);
+}
+
+size_t GetTriangleCount(const Scene* pScene)
+{
+	size_t triangleCount{};
+	for (const TriangleMesh& mesh : pScene->GetTriangleMeshGeometries())
+		triangleCount += mesh.indices.size() / 3;
+	return triangleCount;
+}
+
+//Scene configuration written next to the benchmark results
+std::string GetBenchmarkLabel(const Scene* pScene, const Options& options)
+{
+	const size_t triangleCount{ GetTriangleCount(pScene) };
+	return pScene->GetSceneName()
+		+ " spheres=" + std::to_string(pScene->GetSphereGeometries().size())
+		+ " planes=" + std::to_string(pScene->GetPlaneGeometries().size())
+		+ " meshes=" + std::to_string(pScene->GetTriangleMeshGeometries().size())
+		+ " triangles=" + std::to_string(triangleCount)
+		+ " lights=" + std::to_string(pScene->GetLights().size())
+		+ " cutoff=" + std::to_string(options.lightCutoff)
+		+ " shadowcutoff=" + std::to_string(options.shadowCutoff)
+		+ " lightmode=" + std::to_string(int(options.lightMode));
+}
+
+constexpr const char* BENCHMARK_COLUMNS{ "scene,spheres,planes,meshes,triangles,lights,cutoff,shadow_cutoff,light_mode" };
+
+//Same configuration as the label, one value per BENCHMARK_COLUMNS column
+std::string GetBenchmarkColumns(const Scene* pScene, const Options& options)
+{
+	//Scene paths can hold commas and quotes, a quoted field keeps them in one column
+	std::string scene{ "\"" };
+	for (const char character : pScene->GetSceneName())
+		scene += character == '"' ? std::string{ "\"\"" } : std::string{ character };
+	scene += '"';
+
+	//Same names as --light-mode
+	constexpr const char* lightModeNames[]{ "area", "radiance", "brdf", "combined", "path", "ao" };
+	static_assert(std::size(lightModeNames) == size_t(Renderer::LightingMode::Count));
+
+	return scene
+		+ "," + std::to_string(pScene->GetSphereGeometries().size())
+		+ "," + std::to_string(pScene->GetPlaneGeometries().size())
+		+ "," + std::to_string(pScene->GetTriangleMeshGeometries().size())
+		+ "," + std::to_string(GetTriangleCount(pScene))
+		+ "," + std::to_string(pScene->GetLights().size())
+		+ "," + std::to_string(options.lightCutoff)
+		+ "," + std::to_string(options.shadowCutoff)
+		+ "," + lightModeNames[size_t(options.lightMode)];
+}
+
+//Waits until every submitted frame is written, returns the frame number the next recording starts at
+uint32_t StopRecording(FrameWriter*& pFrameWriter)
+{
+	const uint32_t nextFrameNumber{ pFrameWriter->GetNextFrameNumber() };
+	pFrameWriter->Flush();
+	std::cout << "**RECORDING STOPPED** " << pFrameWriter->GetSubmittedFrameCount() << " frames";
+	if (const uint32_t failedCount{ pFrameWriter->GetFailedFrameCount() })
+		std::cout << ", " << failedCount << " could not be written";
+	std::cout << "\n";
+	delete pFrameWriter;
+	pFrameWriter = nullptr;
+	return nextFrameNumber;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Command line
+	Options options{};
+	try
+	{
+		if (!ParseCommandLine(argc, args, options))
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	catch (const std::exception&)
+	{
+		//std::stoi and friends throw on malformed numbers
+		PrintUsage();
+		return 1;
+	}
+
+	//stdout carries the frames, console messages go to stderr
+	if (options.recordPattern == "-")
+		std::cout.rdbuf(std::cerr.rdbuf());
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
+	const bool isTileWorker{ !options.workerAddress.empty() };
+	const bool isStill{ !options.stillFilename.empty() };
+	//A still never touches the window, a single tile keeps it from allocating a full size surface
+	const int width = isStill ? Renderer::TILE_SIZE : options.width;
+	const int height = isStill ? Renderer::TILE_SIZE : options.height;
 
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"RayTracer - **Raileanu Ioana (2DAE10)**",
 		SDL_WINDOWPOS_UNDEFINED,
 		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+		width, height, isTileWorker || isStill ? SDL_WINDOW_HIDDEN : 0);
 
 	if (!pWindow)
 		return 1;
@@ -44,15 +306,118 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
+	Renderer::SetShadowCutoff(options.shadowCutoff);
+	Renderer::SetSamplerType(options.samplerType);
+	Renderer::SetAreaLightSamples(options.areaLightSamples);
+	Renderer::SetMaxBounces(options.bounces);
+	Renderer::SetRayBudget(options.rayBudget);
+	Renderer::SetLightMode(options.lightMode);
+	Renderer::SetAmbientOcclusionSamples(options.ambientOcclusionSamples);
+	Renderer::SetAmbientOcclusionRadius(options.ambientOcclusionRadius);
+	Renderer::SetAmbientRadiance(options.ambientRadiance);
+	if (options.frameBudget > 0.f)
+	{
+		Renderer::SetFrameBudget(options.frameBudget);
+		Renderer::ToggleDeadline();
+	}
 
-	const auto pScene = new Scene_W3();
+	const auto pScene = CreateScene(options);
 	pScene->Initialize();
+	//A benchmark, still or tile worker of a partial scene would finish without anyone noticing
+	if (!pScene->IsLoaded())
+	{
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+		ShutDown(pWindow);
+		return 1;
+	}
+	if (options.lightCutoff > 0.f)
+		pScene->SetLightCutoff(options.lightCutoff);
+
+	if (isTileWorker)
+	{
+		const int exitCode{ RunTileWorker(options.workerAddress, pScene, pRenderer, pTimer) };
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+		ShutDown(pWindow);
+		return exitCode;
+	}
+
+	if (isStill)
+	{
+		pTimer->Start();
+		pScene->Update(pTimer);
+		const bool isWritten{ pRenderer->RenderStill(pScene, options.width, options.height, options.stillFilename, options.sampleCount) };
+		pTimer->Update();
+		if (isWritten)
+		{
+			std::cout << "Still saved to " << options.stillFilename << " in " << pTimer->GetTotal() << "s\n";
+			if (Renderer::GetBounceLimit() > 0 || Renderer::GetLightMode() == Renderer::LightingMode::PathTraced)
+				std::cout << "Secondary rays: " << pRenderer->GetSecondaryRayCount() << "\n";
+		}
+		else
+			std::cout << "Cannot write " << options.stillFilename << "\n";
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+		ShutDown(pWindow);
+		return isWritten ? 0 : 1;
+	}
+
+	//Checkpoints store the accumulation of a progressive mode, the many lights one unless another mode already converges over frames
+	RenderCheckpoint checkpoint{};
+	uint32_t resumedSampleCount{};
+	if (!options.resumeFilename.empty())
+	{
+		if (!Checkpoint::Load(options.resumeFilename, checkpoint) || !pRenderer->ResumeCheckpoint(pScene, checkpoint))
+		{
+			std::cout << "Cannot resume from " << options.resumeFilename << ", it is missing or was rendered at another resolution or with other lights\n";
+			delete pScene;
+			delete pRenderer;
+			delete pTimer;
+			ShutDown(pWindow);
+			return 1;
+		}
+		resumedSampleCount = checkpoint.accumulatedFrames;
+		std::cout << "Resuming at " << resumedSampleCount << " samples\n";
+	}
+	else if ((!options.checkpointFilename.empty() || options.sampleCount > 0) && !Renderer::IsProgressive())
+	{
+		Renderer::Settings settings{ Renderer::GetSettings() };
+		settings.manyLightsEnabled = true;
+		Renderer::ApplySettings(settings);
+	}
+	const std::string& checkpointFilename{ options.checkpointFilename.empty() ? options.resumeFilename : options.checkpointFilename };
+	CheckpointWriter* pCheckpointWriter{ checkpointFilename.empty() ? nullptr : new CheckpointWriter(checkpointFilename) };
+	float checkpointTimer{ 0.f };
+
+	TileCoordinator* pCoordinator{};
+	if (options.coordinatorPort > 0)
+	{
+		pCoordinator = new TileCoordinator(static_cast<uint16_t>(options.coordinatorPort), !options.isListeningOnAllInterfaces);
+		if (!pCoordinator->IsListening())
+			std::cout << "Cannot listen on port " << options.coordinatorPort << ", rendering locally\n";
+		else if (options.workerCount > 0)
+		{
+			pCoordinator->WaitForWorkers(options.workerCount, 30.f, pRenderer);
+			std::cout << pCoordinator->GetWorkerCount() << " tile workers connected\n";
+		}
+	}
+
+	FrameWriter* pFrameWriter{ options.recordPattern.empty() ? nullptr : new FrameWriter(options.recordPattern, width, height) };
+	//Every recording of a run continues the numbering, a new one would overwrite the frames of the previous
+	uint32_t nextRecordedFrame{};
 
 	//Start loop
 	pTimer->Start();
 
 	// Start Benchmark
-	// pTimer->StartBenchmark();
+	pTimer->SetBenchmarkLabel(GetBenchmarkLabel(pScene, options));
+	pTimer->SetBenchmarkColumns(BENCHMARK_COLUMNS, GetBenchmarkColumns(pScene, options));
+	if (options.benchmarkFrames > 0)
+		pTimer->StartBenchmark(options.benchmarkFrames);
 
 	float printTimer = 0.f;
 	bool isLooping = true;
@@ -75,8 +440,41 @@ int main(int argc, char* args[])
 					Renderer::ToggleShadow();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					Renderer::ToggleLightMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					Renderer::ToggleManyLights();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					Renderer::ToggleLightCulling();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pTimer->StartBenchmark();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					Renderer::ToggleWavefront();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					Renderer::ToggleTemporalReuse();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					Renderer::ToggleChangedTiles();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+				{
+					if (pFrameWriter)
+						nextRecordedFrame = StopRecording(pFrameWriter);
+					else
+					{
+						pFrameWriter = new FrameWriter(options.recordPattern.empty() ? DEFAULT_RECORD_PATTERN : options.recordPattern, width, height,
+							nextRecordedFrame);
+						std::cout << "**RECORDING STARTED**\n";
+					}
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					Renderer::ToggleDeadline();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+				{
+					Renderer::ToggleSampler();
+					std::cout << "Sampler: " << Sampler::GetName(Renderer::GetSettings().samplerType) << "\n";
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_B)
+				{
+					Renderer::ToggleBounces();
+					std::cout << "Reflections and refractions " << (Renderer::AreBouncesEnabled() ? "on" : "off") << "\n";
+				}
 				break;
 			}
 		}
@@ -85,15 +483,51 @@ int main(int argc, char* args[])
 		pScene->Update(pTimer);
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		if (pCoordinator && pCoordinator->IsListening())
+			pCoordinator->RenderFrame(pScene, pTimer, pRenderer);
+		else
+			pRenderer->Render(pScene);
+		if (pFrameWriter)
+			pFrameWriter->Submit(SDL_GetWindowSurface(pWindow));
+		if (resumedSampleCount > 0)
+		{
+			//The checkpoint's camera and geometry are compared against the first frame
+			if (pRenderer->GetAccumulatedFrames() != resumedSampleCount + 1)
+				std::cout << "The scene does not match the checkpoint, the accumulation started over\n";
+			resumedSampleCount = 0;
+		}
+		if (options.sampleCount > 0 && pRenderer->GetAccumulatedFrames() >= options.sampleCount)
+		{
+			isLooping = false;
+			takeScreenshot = true;
+		}
 
 		//--------- Timer ---------
 		pTimer->Update();
+		if (options.benchmarkFrames > 0 && !pTimer->IsBenchmarkActive())
+			isLooping = false;
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			if (Renderer::GetLightMode() == Renderer::LightingMode::PathTraced)
+			{
+				//One path per pixel and frame, throughput comparable across scenes and machines
+				const float pixelCount{ float(width) * height };
+				std::cout << "Path samples: " << pTimer->GetdFPS() * pixelCount << " per second, "
+					<< 1.f + pRenderer->GetSecondaryRayCount() / pixelCount << " rays per path, "
+					<< pRenderer->GetAccumulatedFrames() << " per pixel\n";
+			}
+			else if (Renderer::GetBounceLimit() > 0)
+				std::cout << "Secondary rays: " << pRenderer->GetSecondaryRayCount() << " per frame (depth " << Renderer::GetBounceLimit() << ")\n";
+		}
+		checkpointTimer += pTimer->GetElapsed();
+		if (pCheckpointWriter && checkpointTimer >= options.checkpointInterval)
+		{
+			checkpointTimer = 0.f;
+			if (pRenderer->CaptureCheckpoint(pScene, checkpoint))
+				pCheckpointWriter->Submit(checkpoint);
 		}
 
 		//Save screenshot after full render
@@ -107,8 +541,21 @@ int main(int argc, char* args[])
 		}
 	}
 	pTimer->Stop();
+	if (pFrameWriter)
+		StopRecording(pFrameWriter);
+	if (pCheckpointWriter)
+	{
+		const bool isCaptured{ pRenderer->CaptureCheckpoint(pScene, checkpoint) };
+		if (isCaptured)
+			pCheckpointWriter->Submit(checkpoint);
+		pCheckpointWriter->Flush();
+		if (isCaptured && pCheckpointWriter->GetFailedCount() == 0)
+			std::cout << "Checkpoint saved to " << pCheckpointWriter->GetFilename() << " at " << pRenderer->GetAccumulatedFrames() << " samples\n";
+		delete pCheckpointWriter;
+	}
 
 	//Shutdown "framework"
+	delete pCoordinator;
 	delete pScene;
 	delete pRenderer;
 	delete pTimer;